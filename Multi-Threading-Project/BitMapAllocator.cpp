@@ -6,6 +6,7 @@
 
 #include "BitMapAllocator.h"
 
+#include <algorithm>
 #include <cstring>
 #include <iomanip>
 #include <ios>
@@ -15,45 +16,71 @@
 using mem::Addr;
 using mem::kPageSize;
 
+namespace {
+  // Source for zeroing page frames
+  const uint8_t kZeroPages[16 * kPageSize] = {};
+}
+
 BitMapAllocator::BitMapAllocator(mem::MMU &memory_) 
-: memory(memory_)
+: memory(memory_), frame_count(memory_.get_frame_count()),
+  bit_map_bytes((frame_count + 7) / 8),
+  reserved_frames((kBitMapStart + bit_map_bytes + kPageSize - 1) / kPageSize),
+  bit_map((frame_count + 63) / 64, 0), summary((bit_map.size() + 63) / 64, 0),
+  dirty_begin(0), dirty_end(0), frames_allocated(0), frames_freed(0),
+  in_use(0), peak_in_use(0), zero_state(frame_count, kDirtyFrame),
+  zero_hits(0), zero_misses(0), zero_lock(nullptr), zero_stop(false),
+  kernel_lock(nullptr)
 {
-  size_t page_frame_count = memory.get_frame_count();
-  if (page_frame_count < 2 || page_frame_count > kMaxPageFrames) {
+  if (frame_count < 2 || frame_count > kMaxPageFrames) {
     throw std::runtime_error("page_frame_count out of range");
   }
   
-  // Initialize all page frames as available except for 0 and frames beyond end
-  StoreBit(0, kInUse);    // set page frame 0 unavailable 
-  for (size_t i = 1; i < page_frame_count; ++i) {
-    StoreBit(i, kFree);   // mark page as available
-  }
-  for (size_t i = page_frame_count; i < kMaxPageFrames; ++i) {
-    StoreBit(i, kInUse);  // mark page frames beyond end as unavailable
+  // Initialize all page frames as available except those holding the bit
+  // map, a word at a time, and write the whole bit map at once
+  for (size_t index = 0; index < bit_map.size(); ++index) {
+    uint64_t word = ~uint64_t(0);
+    if (index * 64 < reserved_frames) {
+      word = (reserved_frames - index * 64 >= 64)
+              ? 0 : word << (reserved_frames - index * 64);
+    }
+    if ((index + 1) * 64 > frame_count) {
+      word &= ~uint64_t(0) >> ((index + 1) * 64 - frame_count);
+    }
+    StoreWord(index, word);
   }
+  dirty_begin = 0;
+  dirty_end = bit_map_bytes;
+  WriteBitMap();
   
   // Write count of free page frames to memory
-  uint32_t free_count = page_frame_count - 1;
+  uint32_t free_count = frame_count - reserved_frames;
   memory.movb(kFreeCount, &free_count, sizeof(uint32_t));
+  
+  // Start with all free page frames zeroed; they are one run
+  std::vector<Addr> frame_addrs;
+  for (size_t i = reserved_frames; i < frame_count; ++i) {
+    frame_addrs.push_back(i * kPageSize);
+    zero_state[i] = kZeroedFrame;
+  }
+  ClearFrames(frame_addrs);
+}
+
+BitMapAllocator::~BitMapAllocator() {
+  StopZeroing();
 }
 
 bool BitMapAllocator::GetFrames(uint32_t count, 
                                 std::vector<Addr> &page_frames) {
+  std::unique_lock<std::recursive_mutex> kernel = LockKernel();
   uint32_t free_count = get_free_count();
   
   // If enough pages available, allocate to caller
   if (count <= free_count) {  // if enough to allocate
-    while (count-- > 0) {
-      // Return next free frame to caller
-      size_t page_frame_addr = GetFirstFree();
-      page_frames.push_back(page_frame_addr);
-      
-      // Clear page frame to all 0
-      uint64_t zero = 0;
-      for (Addr i = 0; i < kPageSize; i += sizeof(zero)) {
-        memory.movb(page_frame_addr + i, &zero, sizeof(zero));
-      }
-    }
+    set_free_count(free_count - count);
+    size_t first = page_frames.size();
+    TakeFree(count, page_frames);
+    PrepareFrames(page_frames, first);
+    CountAllocated(count);
 
     return true;
   } else {
@@ -61,16 +88,43 @@ bool BitMapAllocator::GetFrames(uint32_t count,
   }
 }
 
+bool BitMapAllocator::GetContiguousFrames(uint32_t count, uint32_t alignment,
+                                          std::vector<Addr> &page_frames) {
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+    throw std::invalid_argument("frame alignment must be a power of 2");
+  }
+  if (count == 0) return true;
+  
+  std::unique_lock<std::recursive_mutex> kernel = LockKernel();
+  uint32_t bit_map_free;
+  memory.movb(&bit_map_free, kFreeCount, sizeof(uint32_t));
+  size_t first = page_frames.size();
+  if (count > bit_map_free || !TakeRun(count, alignment, page_frames)) {
+    return false;  // do nothing and return error
+  }
+  set_free_count(bit_map_free - count);
+  PrepareFrames(page_frames, first);
+  CountAllocated(count);
+  return true;
+}
+
 bool BitMapAllocator::FreeFrames(uint32_t count,
                                  std::vector<Addr> &page_frames) {
+  std::unique_lock<std::recursive_mutex> kernel = LockKernel();
+  
   // If enough to deallocate
   if(count <= page_frames.size()) {
+    set_free_count(get_free_count() + count);
+    std::vector<uint32_t> frame_nums;
     while(count-- > 0) {
       // Return next frame to bit map
-      uint32_t frame_addr = page_frames.back();
+      frame_nums.push_back(page_frames.back() / kPageSize);
+      ReleaseFrame(frame_nums.back());
       page_frames.pop_back();
-      FreeFrame(frame_addr);
     }
+    WriteBitMap();
+    QueueZero(frame_nums);
+    CountFreed(frame_nums.size());
 
     return true;
   } else {
@@ -81,9 +135,10 @@ bool BitMapAllocator::FreeFrames(uint32_t count,
 std::string BitMapAllocator::get_bit_map_string(void) const {
   std::ostringstream out_string;
   
-  uint8_t map_byte;
-  for (Addr i = 0; i < kBitMapBytes; ++i) {
-    memory.movb(&map_byte, kBitMapStart + i);
+  std::unique_lock<std::recursive_mutex> kernel = LockKernel();
+  std::vector<uint8_t> map_bytes(bit_map_bytes);
+  memory.movb(map_bytes.data(), kBitMapStart, bit_map_bytes);
+  for (uint8_t map_byte : map_bytes) {
     out_string << " " << std::hex << std::setw(2) << std::setfill('0')
             << static_cast<uint32_t>(map_byte);
   }
@@ -92,6 +147,7 @@ std::string BitMapAllocator::get_bit_map_string(void) const {
 }
 
 uint32_t BitMapAllocator::get_free_count() const {
+  std::unique_lock<std::recursive_mutex> kernel = LockKernel();
   uint32_t free_count;
   memory.movb(&free_count, kFreeCount, sizeof(uint32_t));
   return free_count;
@@ -102,49 +158,298 @@ void BitMapAllocator::set_free_count(uint32_t free_count) {
 }
 
 uint32_t BitMapAllocator::GetBit(uint32_t frame_num) const {
-  uint8_t map_byte;
-  memory.movb(&map_byte, kBitMapStart + frame_num/8);  // get byte from map
-  return (map_byte >> (frame_num % 8)) & 1;
+  return (bit_map[frame_num / 64] >> (frame_num % 64)) & 1;
+}
+
+size_t BitMapAllocator::FindFreeWord(size_t index) const {
+  size_t summary_index = index / 64;
+  if (summary_index >= summary.size()) return bit_map.size();
+  
+  // Skip summary bits below index, then whole summary words with no free
+  uint64_t bits = summary[summary_index] & (~uint64_t(0) << (index % 64));
+  while (bits == 0) {
+    if (++summary_index == summary.size()) return bit_map.size();
+    bits = summary[summary_index];
+  }
+  return summary_index * 64 + __builtin_ctzll(bits);
+}
+
+void BitMapAllocator::StoreWord(size_t index, uint64_t word) {
+  bit_map[index] = word;
+  uint64_t mask = uint64_t(1) << (index % 64);
+  summary[index / 64] = (summary[index / 64] & ~mask) | (word != 0 ? mask : 0);
 }
 
 void BitMapAllocator::StoreBit(uint32_t frame_num,
                                uint8_t value) {
-  size_t index = frame_num / 8;
-  size_t shift = frame_num % 8;
-  uint8_t map_byte;
-  memory.movb(&map_byte, kBitMapStart + index);  // read old value
-  map_byte = (map_byte & ~(1 << shift)) | ((value & 1) << shift);
-  memory.movb(kBitMapStart + index, &map_byte);  // rewrite updated value
+  size_t index = frame_num / 64;
+  uint64_t mask = uint64_t(1) << (frame_num % 64);
+  StoreWord(index, (bit_map[index] & ~mask) | (value & 1 ? mask : 0));
+  
+  Addr byte_index = frame_num / 8;
+  if (dirty_begin == dirty_end) {
+    dirty_begin = byte_index;
+    dirty_end = byte_index + 1;
+  } else {
+    dirty_begin = std::min(dirty_begin, byte_index);
+    dirty_end = std::max(dirty_end, byte_index + 1);
+  }
 }
 
-uint32_t BitMapAllocator::GetFirstFree() {
-  // Use brute-force search. This could be optimized by keeping track of the
-  // last-known lowest free frame.
+uint32_t BitMapAllocator::TakeFree(uint32_t count, std::vector<Addr> &page_frames) {
+  uint32_t taken = 0;
+  if (buddy) {
+    uint32_t frame_num;
+    while (taken < count && buddy->Allocate(0, frame_num)) {
+      StoreBit(frame_num, kInUse);
+      page_frames.push_back(frame_num * kPageSize);
+      ++taken;
+    }
+    WriteBitMap();
+    return taken;
+  }
   
-  // Find first non-zero byte in bitmap
-  uint8_t map_byte = 0;
-  Addr index;
-  for (index = 0; index < kBitMapBytes; ++index) {
-    memory.movb(&map_byte, kBitMapStart + index);
-    if (map_byte != 0) break;
+  size_t index = FindFreeWord(0);
+  size_t last_index = index;
+  Addr first_byte = index * sizeof(uint64_t);
+  while (index < bit_map.size() && taken < count) {
+    // Take free frames in this word lowest first
+    uint64_t word = bit_map[index];
+    while (word != 0 && taken < count) {
+      uint32_t frame_num = index * 64 + __builtin_ctzll(word);
+      word &= word - 1;  // clear lowest set bit
+      page_frames.push_back(frame_num * kPageSize);
+      ++taken;
+    }
+    StoreWord(index, word);
+    last_index = index;
+    index = FindFreeWord(index + 1);
   }
-  if (map_byte == 0) return 0;  // no available page frames
   
-  // Find lowest numbered non-zero bit
-  int shift = 0;
-  while (((map_byte >> shift) & 1) == 0) {
-    ++shift;
+  // Changed words lie in one range
+  if (taken > 0) {
+    Addr last_byte = std::min<Addr>((last_index + 1) * sizeof(uint64_t),
+                                    bit_map_bytes);
+    if (dirty_begin == dirty_end) {
+      dirty_begin = first_byte;
+      dirty_end = last_byte;
+    } else {
+      dirty_begin = std::min(dirty_begin, first_byte);
+      dirty_end = std::max(dirty_end, last_byte);
+    }
+    WriteBitMap();
+  }
+  return taken;
+}
+
+bool BitMapAllocator::TakeRun(uint32_t count, uint32_t alignment,
+                              std::vector<Addr> &page_frames) {
+  uint32_t start;
+  if (buddy) {
+    // Take a whole block, then return the frames past count
+    uint32_t order = BuddyAllocator::OrderFor(std::max(count, alignment));
+    if (!buddy->Allocate(order, start)) return false;
+    for (uint32_t frame_num = start + count; frame_num < start + (1u << order);
+            ++frame_num) {
+      buddy->Free(frame_num, 0);
+    }
+  } else {
+    // Search aligned starts, skipping past each frame in use and each
+    // word with no free frames
+    start = (reserved_frames + alignment - 1) & ~(alignment - 1);
+    uint32_t end = start;
+    while (end < start + count) {
+      if (start + count > frame_count) return false;
+      if (GetBit(end) == kFree) {
+        ++end;
+      } else {
+        uint32_t next = (bit_map[end / 64] == 0) ? FindFreeWord(end / 64 + 1) * 64
+                                                 : end + 1;
+        start = (next + alignment - 1) & ~(alignment - 1);
+        end = start;
+      }
+    }
   }
   
-  // Mark page frame as in use
-  uint32_t frame_num = index * 8 + shift;
-  StoreBit(frame_num, kInUse);
-  return frame_num * kPageSize;  // page frame address
+  for (uint32_t frame_num = start; frame_num < start + count; ++frame_num) {
+    StoreBit(frame_num, kInUse);
+    page_frames.push_back(frame_num * kPageSize);
+  }
+  WriteBitMap();
+  return true;
 }
 
-void BitMapAllocator::FreeFrame(uint32_t frame_addr) {
-  uint32_t frame_num = frame_addr / kPageSize;
+void BitMapAllocator::ReleaseFrame(uint32_t frame_num) {
   StoreBit(frame_num, kFree);
-  set_free_count(get_free_count() + 1);
+  if (buddy) buddy->Free(frame_num, 0);
+}
+
+void BitMapAllocator::EnableBuddy(void) {
+  buddy.reset(new BuddyAllocator(frame_count));
+  for (size_t index = FindFreeWord(0); index < bit_map.size();
+          index = FindFreeWord(index + 1)) {
+    for (uint64_t word = bit_map[index]; word != 0; word &= word - 1) {
+      buddy->Free(index * 64 + __builtin_ctzll(word), 0);
+    }
+  }
+}
+
+void BitMapAllocator::Reload(void) {
+  // Bit map bytes in memory are the bytes of the host words
+  std::vector<uint64_t> words(bit_map.size(), 0);
+  memory.movb(words.data(), kBitMapStart, bit_map_bytes);
+  for (size_t index = 0; index < bit_map.size(); ++index) {
+    StoreWord(index, words[index]);
+  }
+  dirty_begin = dirty_end = 0;
+  if (buddy) EnableBuddy();
+  
+  uint32_t now = frame_count - reserved_frames - get_free_count();
+  in_use = now;
+  if (now > peak_in_use.load()) peak_in_use = now;
+  
+  std::lock_guard<std::mutex> guard(zero_mutex);
+  zero_queue.clear();
+  zero_state.assign(frame_count, uint8_t(kDirtyFrame));
+}
+
+void BitMapAllocator::WriteBitMap(void) {
+  if (dirty_begin == dirty_end) return;
+  
+  memory.movb(kBitMapStart + dirty_begin,
+              reinterpret_cast<const uint8_t *>(bit_map.data()) + dirty_begin,
+              dirty_end - dirty_begin);
+  dirty_begin = dirty_end = 0;
+}
+
+void BitMapAllocator::ClearFrames(std::vector<Addr> frame_addrs) {
+  std::sort(frame_addrs.begin(), frame_addrs.end());
+  for (size_t i = 0; i < frame_addrs.size(); ) {
+    // Find run of adjacent frames
+    size_t end = i + 1;
+    while (end < frame_addrs.size()
+            && frame_addrs[end] == frame_addrs[end - 1] + kPageSize) {
+      ++end;
+    }
+    
+    Addr addr = frame_addrs[i];
+    Addr length = (end - i) * kPageSize;
+    while (length > 0) {
+      Addr chunk = std::min<Addr>(length, sizeof(kZeroPages));
+      memory.movb(addr, kZeroPages, chunk);
+      addr += chunk;
+      length -= chunk;
+    }
+    i = end;
+  }
+}
+
+void BitMapAllocator::PrepareFrames(const std::vector<Addr> &page_frames,
+                                    size_t first) {
+  std::vector<Addr> dirty;
+  {
+    std::lock_guard<std::mutex> lock(zero_mutex);
+    for (size_t i = first; i < page_frames.size(); ++i) {
+      uint32_t frame_num = page_frames[i] / kPageSize;
+      if (zero_state[frame_num] != kZeroedFrame) {
+        dirty.push_back(page_frames[i]);
+      }
+      zero_state[frame_num] = kDirtyFrame;  // a queued entry is now skipped
+    }
+  }
+  zero_hits += page_frames.size() - first - dirty.size();
+  zero_misses += dirty.size();
+  ClearFrames(dirty);
+}
+
+void BitMapAllocator::QueueZero(const std::vector<uint32_t> &frame_nums) {
+  size_t drain = 0;
+  {
+    std::lock_guard<std::mutex> lock(zero_mutex);
+    for (uint32_t frame_num : frame_nums) {
+      zero_state[frame_num] = kQueuedFrame;
+      zero_queue.push_back(frame_num);
+    }
+    if (zero_lock != nullptr) {
+      zero_wanted.notify_one();
+    } else if (zero_queue.size() >= kZeroBatch) {
+      drain = zero_queue.size();
+    }
+  }
+  if (drain > 0) ZeroQueued(drain);
 }
 
+void BitMapAllocator::ZeroQueued(size_t max) {
+  std::unique_lock<std::recursive_mutex> kernel;
+  KernelLock *lock = (zero_lock != nullptr) ? zero_lock : kernel_lock;
+  if (lock != nullptr) kernel = lock->Acquire();
+  std::lock_guard<std::mutex> zero_lock_guard(zero_mutex);
+  memory.set_kernel_mode();
+  
+  // Skip frames allocated again since they were queued
+  std::vector<Addr> frame_addrs;
+  while (max-- > 0 && !zero_queue.empty()) {
+    uint32_t frame_num = zero_queue.back();
+    zero_queue.pop_back();
+    if (zero_state[frame_num] == kQueuedFrame) {
+      frame_addrs.push_back(frame_num * kPageSize);
+      zero_state[frame_num] = kZeroedFrame;
+    }
+  }
+  ClearFrames(frame_addrs);
+}
+
+void BitMapAllocator::StartZeroing(KernelLock &zero_lock_) {
+  if (zero_thread.joinable()) return;
+  zero_lock = &zero_lock_;
+  zero_stop = false;
+  zero_thread = std::thread(&BitMapAllocator::ZeroLoop, this);
+}
+
+void BitMapAllocator::StopZeroing(void) {
+  if (!zero_thread.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(zero_mutex);
+    zero_stop = true;
+    zero_wanted.notify_one();
+  }
+  zero_thread.join();
+  zero_lock = nullptr;
+}
+
+void BitMapAllocator::ZeroLoop(void) {
+  std::unique_lock<std::mutex> lock(zero_mutex);
+  while (true) {
+    zero_wanted.wait(lock, [this] { return zero_stop || !zero_queue.empty(); });
+    if (zero_stop) return;
+    lock.unlock();
+    ZeroQueued(kZeroBatch);
+    lock.lock();
+  }
+}
+
+void BitMapAllocator::EnableThreadSafe(KernelLock &kernel_lock_) {
+  kernel_lock = &kernel_lock_;
+}
+
+std::unique_lock<std::recursive_mutex> BitMapAllocator::LockKernel(void) const {
+  std::unique_lock<std::recursive_mutex> kernel;
+  if (kernel_lock != nullptr) {
+    kernel = kernel_lock->Acquire();
+    memory.set_kernel_mode();
+  }
+  return kernel;
+}
+
+void BitMapAllocator::CountAllocated(uint32_t count) {
+  frames_allocated += count;
+  uint32_t now = in_use += count;
+  uint32_t peak = peak_in_use.load();
+  while (now > peak && !peak_in_use.compare_exchange_weak(peak, now)) {
+  }
+}
+
+void BitMapAllocator::CountFreed(uint32_t count) {
+  frames_freed += count;
+  in_use -= count;
+}
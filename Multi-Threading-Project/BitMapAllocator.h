@@ -7,24 +7,41 @@
 #ifndef BITMAPALLOCATOR_H
 #define BITMAPALLOCATOR_H
 
+#include "BuddyAllocator.h"
+#include "KernelLock.h"
+
 #include <MMU.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 class BitMapAllocator {
 public:
+  // Largest supported memory, in page frames
+  static const mem::Addr kMaxPageFrames = 0x100000;
+  
   /**
    * Constructor
    * 
-   * Built bit map of free page frames.
+   * Built bit map of free page frames. The free count and bit map are
+   * stored at the start of memory, in frames that are never allocated.
    * 
    * @param memory MMU object
+   * @throws std::runtime_error if memory has fewer than 2 or more than
+   *   kMaxPageFrames page frames
    */
   BitMapAllocator(mem::MMU &memory_);
   
-  virtual ~BitMapAllocator() {}  // empty destructor
+  /**
+   * Destructor - stop background zeroing
+   */
+  virtual ~BitMapAllocator();
   
   // Disallow copy/move
   BitMapAllocator(const BitMapAllocator &other) = delete;
@@ -41,6 +58,20 @@ public:
    */
   bool GetFrames(uint32_t count, std::vector<mem::Addr> &page_frames);
   
+  /**
+   * GetContiguousFrames - allocate physically contiguous page frames
+   * 
+   * @param count number of page frames to allocate
+   * @param alignment first frame number is a multiple of this (power of 2)
+   * @param page_frames page frame addresses allocated are pushed on back,
+   *   in ascending order
+   * @return true if success, false if no such run is free (no frames
+   *   allocated)
+   * @throws std::invalid_argument if alignment is not a power of 2
+   */
+  bool GetContiguousFrames(uint32_t count, uint32_t alignment,
+                           std::vector<mem::Addr> &page_frames);
+  
   /**
    * FreeFrames - return page frames to free list
    * 
@@ -51,6 +82,68 @@ public:
    */
   bool FreeFrames(uint32_t count, std::vector<mem::Addr> &page_frames);
   
+  /**
+   * EnableThreadSafe - make the allocator safe to call from any thread
+   * 
+   * This is a locking wrapper, not a concurrent allocator: each call then
+   * holds kernel_lock, which must be the lock serializing all other users
+   * of the MMU, and runs in kernel mode, so calls never overlap. The lock
+   * is recursive, so callers that already hold it (as processes running
+   * traces do) only take it again.
+   * 
+   * Must be called before the allocator is shared between threads.
+   * 
+   * @param kernel_lock_ lock serializing MMU access
+   */
+  void EnableThreadSafe(KernelLock &kernel_lock_);
+  
+  /**
+   * EnableBuddy - choose free frames with a buddy allocator instead of the
+   *   lowest-first bit map search
+   * 
+   * Allocation and free of single frames and of contiguous runs take
+   * O(log n) steps, and freed frames coalesce into larger runs. The bit map
+   * in memory is still kept up to date. Must be called before any
+   * concurrent use.
+   */
+  void EnableBuddy(void);
+  
+  /**
+   * StartZeroing - zero freed page frames on a background thread
+   * 
+   * Frames are zeroed when the allocator is built, and freed frames are
+   * queued to be zeroed again. GetFrames hands out zeroed frames as they
+   * are and zeroes the rest itself. Without a background thread, the queue
+   * is zeroed in bulk by FreeFrames each time it reaches kZeroBatch frames.
+   * 
+   * @param zero_lock_ lock serializing MMU access, held while zeroing
+   */
+  void StartZeroing(KernelLock &zero_lock_);
+  
+  /**
+   * StopZeroing - stop the background thread; queued frames stay queued
+   */
+  void StopZeroing(void);
+  
+  /**
+   * Reload - rebuild the host copy of the bit map from memory, after memory
+   *   was restored from a checkpoint. Free frames are no longer known to be
+   *   zeroed, so GetFrames zeroes them as it hands them out. Must not be
+   *   called in thread-safe mode; if background zeroing runs, the caller
+   *   must hold its lock.
+   */
+  void Reload(void);
+  
+  // Page frames handed out already zeroed, and those GetFrames had to zero
+  uint64_t get_zero_pool_hits(void) const { return zero_hits.load(); }
+  uint64_t get_zero_pool_misses(void) const { return zero_misses.load(); }
+  
+  // Frames handed out and returned since construction, and the most in use
+  // at once
+  uint64_t get_frames_allocated(void) const { return frames_allocated.load(); }
+  uint64_t get_frames_freed(void) const { return frames_freed.load(); }
+  uint32_t get_peak_in_use(void) const { return peak_in_use.load(); }
+  
   // Functions to return list info
   uint32_t get_free_count(void) const;
   
@@ -69,22 +162,37 @@ private:
   // MMU for storage
   mem::MMU &memory;
   
-  // Maximum number of page frames in memory
-  static const mem::Addr kMaxPageFrames = 0x100;
-    
   // Location to store current number of free page frames
   static const mem::Addr kFreeCount = 0;
 
   // Address of start of bit map in memory (just after free count)
   static const mem::Addr kBitMapStart = kFreeCount + sizeof(uint32_t);
   
-  // Number of bytes in bit map
-  static const mem::Addr kBitMapBytes = (kMaxPageFrames + 7) / 8;
+  // Number of page frames, bytes in bit map, and frames holding the free
+  // count and bit map (never allocated)
+  uint32_t frame_count;
+  mem::Addr bit_map_bytes;
+  uint32_t reserved_frames;
   
   void set_free_count(uint32_t free_count);
   
+  // Host copy of the bit map, 64 frames per word (bit set if free). Bit
+  // map bytes in memory are the bytes of these words, so ranges of the
+  // copy are written back with one movb.
+  std::vector<uint64_t> bit_map;
+  
+  // Summary of the bit map, one bit per bit map word (set if the word has
+  // a free frame), so a free frame is found in a few word scans even in
+  // large memories
+  std::vector<uint64_t> summary;
+  
+  // Range of bit map bytes changed since the last WriteBitMap
+  mem::Addr dirty_begin;
+  mem::Addr dirty_end;
+  
   /**
-   * StoreBit - store the value of a bit map bit
+   * StoreBit - store the value of a bit map bit in the host copy; the
+   *   change reaches memory on the next WriteBitMap
    * 
    * @param frame_num bit number to store
    * @param value new value, 0 or 1
@@ -97,19 +205,127 @@ private:
    * @return kFree or kInUse for that page frame
    */
   uint32_t GetBit(uint32_t frame_num) const;
+  
+  /**
+   * FindFreeWord - find a bit map word with a free frame
+   * @param index first word to look at
+   * @return index of first such word at or after index, or the number of
+   *   words if none
+   */
+  size_t FindFreeWord(size_t index) const;
+  
+  /**
+   * StoreWord - store a bit map word in the host copy and update its
+   *   summary bit
+   */
+  void StoreWord(size_t index, uint64_t word);
 
   /**
-   * GetFirstFree - mark as in-use the first free page frame
+   * TakeFree - mark in use the lowest numbered free page frames, in one
+   *   pass over the bit map. Does not change the free count.
    * 
-   * @return page frame address or 0 if none available
+   * @param count number of page frames wanted
+   * @param page_frames page frame addresses are appended here
+   * @return number of page frames taken (less than count only if the bit
+   *   map runs out)
    */
-  uint32_t GetFirstFree();
+  uint32_t TakeFree(uint32_t count, std::vector<mem::Addr> &page_frames);
 
   /**
-   * FreeFrame - free the specified frame number
-   * @param frame_addr page frame address
+   * TakeRun - mark in use a run of free page frames. Does not change the
+   *   free count.
+   * 
+   * @param count number of page frames
+   * @param alignment first frame number is a multiple of this
+   * @param page_frames page frame addresses are appended here, ascending
+   * @return true if success, false if no such run is free
+   */
+  bool TakeRun(uint32_t count, uint32_t alignment,
+               std::vector<mem::Addr> &page_frames);
+  
+  /**
+   * ReleaseFrame - mark a page frame free in the bit map (and buddy
+   *   allocator, if enabled)
+   * @param frame_num page frame number
+   */
+  void ReleaseFrame(uint32_t frame_num);
+  
+  // Usage counters
+  std::atomic<uint64_t> frames_allocated;
+  std::atomic<uint64_t> frames_freed;
+  std::atomic<uint32_t> in_use;
+  std::atomic<uint32_t> peak_in_use;
+  
+  // Update usage counters after a successful allocation or free
+  void CountAllocated(uint32_t count);
+  void CountFreed(uint32_t count);
+  
+  // Free frame index replacing the bit map search; nullptr if not enabled
+  std::unique_ptr<BuddyAllocator> buddy;
+  
+  /**
+   * WriteBitMap - copy changed bytes of the bit map to memory
+   */
+  void WriteBitMap(void);
+  
+  // Zero state of each page frame
+  static const uint8_t kDirtyFrame = 0;
+  static const uint8_t kQueuedFrame = 1;   // free, in zero_queue
+  static const uint8_t kZeroedFrame = 2;
+  
+  // Queued frames zeroed at a time
+  static const size_t kZeroBatch = 32;
+  
+  // Zero state, queue and counts; lock order is kernel lock, then zero_mutex
+  std::mutex zero_mutex;
+  std::vector<uint8_t> zero_state;
+  std::vector<uint32_t> zero_queue;
+  std::atomic<uint64_t> zero_hits;
+  std::atomic<uint64_t> zero_misses;
+  
+  // Background zeroing; zero_lock is nullptr if not running
+  KernelLock *zero_lock;
+  bool zero_stop;
+  std::condition_variable zero_wanted;
+  std::thread zero_thread;
+  
+  /**
+   * ClearFrames - set all bytes of page frames to 0, one movb per run of
+   *   adjacent frames
+   * @param frame_addrs page frame addresses, in any order
+   */
+  void ClearFrames(std::vector<mem::Addr> frame_addrs);
+  
+  /**
+   * PrepareFrames - make newly allocated page frames all 0, zeroing those
+   *   not already zeroed
+   * @param page_frames page frame addresses
+   * @param first index of first newly allocated frame in page_frames
+   */
+  void PrepareFrames(const std::vector<mem::Addr> &page_frames, size_t first);
+  
+  /**
+   * QueueZero - queue freed page frames to be zeroed
+   * @param frame_nums page frame numbers
+   */
+  void QueueZero(const std::vector<uint32_t> &frame_nums);
+  
+  /**
+   * ZeroQueued - zero up to max queued page frames
+   */
+  void ZeroQueued(size_t max);
+  
+  // Background thread body
+  void ZeroLoop(void);
+  
+  // Lock for MMU access in thread-safe mode; nullptr if not thread safe
+  KernelLock *kernel_lock;
+  
+  /**
+   * LockKernel - in thread-safe mode, take kernel_lock and enter kernel mode
+   * @return lock, empty if not in thread-safe mode
    */
-  void FreeFrame(mem::Addr frame_addr);
+  std::unique_lock<std::recursive_mutex> LockKernel(void) const;
 };
 
 #endif /* BITMAPALLOCATOR_H */
@@ -0,0 +1,79 @@
+/*
+ * File:   BuddyAllocator.cpp
+ *
+ * Created on October 17, 2026
+ */
+
+#include "BuddyAllocator.h"
+
+#include <stdexcept>
+
+const uint32_t BuddyAllocator::kNone;
+const uint8_t BuddyAllocator::kNotFree;
+
+BuddyAllocator::BuddyAllocator(uint32_t frame_count_)
+: frame_count(frame_count_), max_order(OrderFor(frame_count_)),
+  free_head(max_order + 1, kNone), free_order(frame_count_, kNotFree),
+  next(frame_count_, kNone), prev(frame_count_, kNone)
+{
+  if (frame_count == 0) {
+    throw std::invalid_argument("buddy allocator needs at least one frame");
+  }
+}
+
+bool BuddyAllocator::Allocate(uint32_t order, uint32_t &frame_num) {
+  // Find smallest free block that is large enough
+  uint32_t found = order;
+  while (found <= max_order && free_head[found] == kNone) {
+    ++found;
+  }
+  if (found > max_order) return false;
+
+  frame_num = free_head[found];
+  RemoveFree(frame_num);
+
+  // Split, freeing the upper half at each step
+  while (found > order) {
+    --found;
+    PushFree(frame_num + (1u << found), found);
+  }
+  return true;
+}
+
+void BuddyAllocator::Free(uint32_t frame_num, uint32_t order) {
+  while (order < max_order) {
+    uint32_t buddy = frame_num ^ (1u << order);
+    if (buddy >= frame_count || free_order[buddy] != order) break;
+    RemoveFree(buddy);
+    if (buddy < frame_num) frame_num = buddy;
+    ++order;
+  }
+  PushFree(frame_num, order);
+}
+
+uint32_t BuddyAllocator::OrderFor(uint32_t count) {
+  uint32_t order = 0;
+  while ((1u << order) < count) {
+    ++order;
+  }
+  return order;
+}
+
+void BuddyAllocator::PushFree(uint32_t frame_num, uint32_t order) {
+  free_order[frame_num] = order;
+  prev[frame_num] = kNone;
+  next[frame_num] = free_head[order];
+  if (free_head[order] != kNone) prev[free_head[order]] = frame_num;
+  free_head[order] = frame_num;
+}
+
+void BuddyAllocator::RemoveFree(uint32_t frame_num) {
+  uint32_t order = free_order[frame_num];
+  if (prev[frame_num] != kNone) {
+    next[prev[frame_num]] = next[frame_num];
+  } else {
+    free_head[order] = next[frame_num];
+  }
+  if (next[frame_num] != kNone) prev[next[frame_num]] = prev[frame_num];
+  free_order[frame_num] = kNotFree;
+}
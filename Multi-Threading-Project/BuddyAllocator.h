@@ -0,0 +1,89 @@
+/*
+ * File:   BuddyAllocator.h
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef BUDDYALLOCATOR_H
+#define BUDDYALLOCATOR_H
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * BuddyAllocator - index of free page frame numbers as naturally aligned
+ * power-of-two blocks.
+ *
+ * A block of order k holds 2^k frames starting at a multiple of 2^k. Each
+ * order has a doubly linked free list threaded through per-frame arrays, so
+ * allocate and free take O(log n) steps: splitting a larger block on
+ * allocate, and coalescing with free buddies on free.
+ *
+ * Only frame numbers are tracked; the caller keeps the bit map in memory.
+ */
+class BuddyAllocator {
+public:
+  /**
+   * Constructor - all frames start in use
+   *
+   * @param frame_count number of page frames
+   */
+  explicit BuddyAllocator(uint32_t frame_count);
+
+  virtual ~BuddyAllocator() {}  // empty destructor
+
+  // Disallow copy/move
+  BuddyAllocator(const BuddyAllocator &other) = delete;
+  BuddyAllocator(BuddyAllocator &&other) = delete;
+  BuddyAllocator &operator=(const BuddyAllocator &other) = delete;
+  BuddyAllocator &operator=(BuddyAllocator &&other) = delete;
+
+  /**
+   * Allocate - take a free block, splitting a larger one if needed
+   *
+   * @param order block holds 2^order frames
+   * @param frame_num returns first frame number of block
+   * @return true if success, false if no block that large is free
+   */
+  bool Allocate(uint32_t order, uint32_t &frame_num);
+
+  /**
+   * Free - return a block, coalescing it with free buddies
+   *
+   * @param frame_num first frame number of block
+   * @param order block holds 2^order frames
+   */
+  void Free(uint32_t frame_num, uint32_t order);
+
+  /**
+   * OrderFor - smallest order whose blocks hold count frames
+   *
+   * @param count number of frames, at least 1
+   * @return order
+   */
+  static uint32_t OrderFor(uint32_t count);
+
+  // Largest order of any block
+  uint32_t get_max_order(void) const { return max_order; }
+
+private:
+  static const uint32_t kNone = 0xFFFFFFFF;
+  static const uint8_t kNotFree = 0xFF;
+
+  uint32_t frame_count;
+  uint32_t max_order;
+
+  // First free block of each order
+  std::vector<uint32_t> free_head;
+
+  // For the first frame of each free block: its order and list links
+  std::vector<uint8_t> free_order;
+  std::vector<uint32_t> next;
+  std::vector<uint32_t> prev;
+
+  void PushFree(uint32_t frame_num, uint32_t order);
+  void RemoveFree(uint32_t frame_num);
+};
+
+#endif /* BUDDYALLOCATOR_H */
+
@@ -0,0 +1,289 @@
+/*
+ * File:   Checkpoint.cpp
+ *
+ * Created on October 17, 2026
+ */
+
+#include "Checkpoint.h"
+#include "CompareKernels.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using mem::kPageSize;
+
+const uint32_t Checkpoint::kVersion;
+
+namespace {
+  const char kMagic[4] = { 'C', 'K', 'P', 'T' };
+
+  // Frames read from memory with one movb when comparing
+  const size_t kChunkFrames = 64;
+
+  struct RecordHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t frame_count;
+    uint32_t page_count;
+    uint64_t state_words;
+    uint64_t length;
+  };
+
+  // Complete record of a mapped image
+  struct Record {
+    const RecordHeader *header;
+    const uint32_t *state;       // header->state_words words
+    const uint32_t *frame_nums;  // header->page_count frame numbers
+    const uint8_t *pages;        // header->page_count pages
+  };
+
+  // Read-only mapping of an image file, unmapped when destroyed
+  class ImageMap {
+  public:
+    explicit ImageMap(const std::string &file_name) : data(nullptr), size(0) {
+      int fd = open(file_name.c_str(), O_RDONLY);
+      struct stat file_stat;
+      if (fd < 0 || fstat(fd, &file_stat) != 0) {
+        if (fd >= 0) close(fd);
+        throw std::runtime_error("failed to open checkpoint: " + file_name);
+      }
+      size = file_stat.st_size;
+      if (size > 0) {
+        void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+          close(fd);
+          throw std::runtime_error("failed to map checkpoint: " + file_name);
+        }
+        data = static_cast<const uint8_t *>(map);
+      }
+      close(fd);
+    }
+
+    ~ImageMap() {
+      if (data != nullptr) munmap(const_cast<uint8_t *>(data), size);
+    }
+
+    ImageMap(const ImageMap &other) = delete;
+    ImageMap &operator=(const ImageMap &other) = delete;
+
+    const uint8_t *data;
+    size_t size;
+  };
+
+  /**
+   * ScanImage - find the complete records of an image, stopping at the
+   *   first that is cut short or not a record
+   *
+   * @param image mapped image
+   * @param records complete records are pushed on back, in order
+   * @return length of the complete records, in bytes
+   */
+  size_t ScanImage(const ImageMap &image, std::vector<Record> &records) {
+    size_t pos = 0;
+    while (image.size - pos >= sizeof(RecordHeader)) {
+      const RecordHeader *header = reinterpret_cast<const RecordHeader *>(image.data + pos);
+      if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0
+              || header->version != Checkpoint::kVersion) {
+        break;
+      }
+      uint64_t length = sizeof(RecordHeader) + header->state_words * sizeof(uint32_t)
+              + uint64_t(header->page_count) * (sizeof(uint32_t) + kPageSize);
+      if (header->length != length || length > image.size - pos) break;
+
+      Record record;
+      record.header = header;
+      record.state = reinterpret_cast<const uint32_t *>(header + 1);
+      record.frame_nums = record.state + header->state_words;
+      record.pages = reinterpret_cast<const uint8_t *>(record.frame_nums + header->page_count);
+      records.push_back(record);
+      pos += length;
+    }
+    return pos;
+  }
+
+  // 64 bit values are saved as two words, low word first
+  void Push64(std::vector<uint32_t> &words, uint64_t value) {
+    words.push_back(static_cast<uint32_t>(value));
+    words.push_back(static_cast<uint32_t>(value >> 32));
+  }
+
+  uint64_t Take64(const uint32_t *&next, const uint32_t *end) {
+    if (end - next < 2) throw std::runtime_error("checkpoint state is truncated");
+    uint64_t value = next[0] | (uint64_t(next[1]) << 32);
+    next += 2;
+    return value;
+  }
+}
+
+Checkpoint::Checkpoint(const std::string &file_name_, mem::MMU &memory_,
+                       ManagePageTable &pt_manager_, bool append)
+: file_name(file_name_), memory(memory_), pt_manager(pt_manager_), fd(-1),
+  record_count(0), page_count(0)
+{
+  size_t length = 0;
+  if (append) {
+    ImageMap image(file_name);
+    std::vector<Record> records;
+    length = ScanImage(image, records);
+  }
+  fd = open(file_name.c_str(), O_WRONLY | O_CREAT | (append ? 0 : O_TRUNC), 0600);
+  if (fd < 0) {
+    throw std::runtime_error("failed to create checkpoint: " + file_name);
+  }
+
+  // Drop a record cut short, and compare later records with the memory
+  // just restored
+  if (append) {
+    if (ftruncate(fd, length) != 0 || lseek(fd, 0, SEEK_END) < 0) {
+      close(fd);
+      throw std::runtime_error("failed to write checkpoint: " + file_name);
+    }
+    saved.resize(size_t(memory.get_frame_count()) * kPageSize);
+    memory.movb(saved.data(), 0, saved.size());
+  }
+}
+
+Checkpoint::~Checkpoint(void) {
+  close(fd);
+}
+
+void Checkpoint::Write(const TraceState &state) {
+  std::vector<uint32_t> words;
+  Push64(words, state.line_number);
+  Push64(words, state.offset);
+  words.push_back(state.record);
+  Push64(words, state.user_psw0);
+  words.push_back(state.process_psw0s.size());
+  for (mem::PSW psw0 : state.process_psw0s) {
+    Push64(words, psw0);
+  }
+  pt_manager.SaveState(words);
+
+  // Find frames changed since the last record (all, for the first),
+  // updating the saved copy
+  size_t frame_count = memory.get_frame_count();
+  bool full = saved.empty();
+  if (full) saved.resize(frame_count * kPageSize);
+  std::vector<uint32_t> frame_nums;
+  std::vector<uint8_t> chunk(kChunkFrames * kPageSize);
+  for (size_t first = 0; first < frame_count; first += kChunkFrames) {
+    size_t count = std::min(kChunkFrames, frame_count - first);
+    memory.movb(chunk.data(), first * kPageSize, count * kPageSize);
+    for (size_t i = 0; i < count; ++i) {
+      const uint8_t *page = chunk.data() + i * kPageSize;
+      uint8_t *copy = saved.data() + (first + i) * kPageSize;
+      if (full || compare::FindDifferent(page, copy, kPageSize) != kPageSize) {
+        memcpy(copy, page, kPageSize);
+        frame_nums.push_back(first + i);
+      }
+    }
+  }
+
+  // Pad so that the next record stays 8 byte aligned
+  if ((words.size() + frame_nums.size()) % 2 != 0) words.push_back(0);
+
+  RecordHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.frame_count = frame_count;
+  header.page_count = frame_nums.size();
+  header.state_words = words.size();
+  header.length = sizeof(header) + words.size() * sizeof(uint32_t)
+          + uint64_t(frame_nums.size()) * (sizeof(uint32_t) + kPageSize);
+  WriteAll(&header, sizeof(header));
+  WriteAll(words.data(), words.size() * sizeof(uint32_t));
+  WriteAll(frame_nums.data(), frame_nums.size() * sizeof(uint32_t));
+
+  // Pages of adjacent frames are written together
+  for (size_t i = 0; i < frame_nums.size(); ) {
+    size_t end = i + 1;
+    while (end < frame_nums.size() && frame_nums[end] == frame_nums[end - 1] + 1) {
+      ++end;
+    }
+    WriteAll(saved.data() + size_t(frame_nums[i]) * kPageSize, (end - i) * kPageSize);
+    i = end;
+  }
+  if (fdatasync(fd) != 0) {
+    throw std::runtime_error("failed to write checkpoint: " + file_name);
+  }
+  ++record_count;
+  page_count += frame_nums.size();
+}
+
+void Checkpoint::WriteAll(const void *data, size_t length) {
+  const char *bytes = static_cast<const char *>(data);
+  size_t done = 0;
+  while (done < length) {
+    ssize_t written = write(fd, bytes + done, length - done);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      throw std::runtime_error("failed to write checkpoint: " + file_name);
+    }
+    done += written;
+  }
+}
+
+Checkpoint::TraceState Checkpoint::Restore(const std::string &file_name,
+                                           mem::MMU &memory,
+                                           ManagePageTable &pt_manager) {
+  ImageMap image(file_name);
+  std::vector<Record> records;
+  ScanImage(image, records);
+  if (records.empty()) {
+    throw std::runtime_error("no complete checkpoint in " + file_name);
+  }
+
+  // Latest copy of each frame, taken from the records in order
+  size_t frame_count = memory.get_frame_count();
+  std::vector<const uint8_t *> pages(frame_count, nullptr);
+  for (const Record &record : records) {
+    if (record.header->frame_count != frame_count) {
+      throw std::runtime_error("checkpoint is for a different memory size: " + file_name);
+    }
+    for (uint32_t i = 0; i < record.header->page_count; ++i) {
+      uint32_t frame_num = record.frame_nums[i];
+      if (frame_num >= frame_count) {
+        throw std::runtime_error("invalid checkpoint: " + file_name);
+      }
+      pages[frame_num] = record.pages + size_t(i) * kPageSize;
+    }
+  }
+  if (std::find(pages.begin(), pages.end(), nullptr) != pages.end()) {
+    throw std::runtime_error("checkpoint has no full image: " + file_name);
+  }
+
+  // Copy runs of frames that are adjacent in the image with one movb
+  for (size_t i = 0; i < frame_count; ) {
+    size_t end = i + 1;
+    while (end < frame_count && pages[end] == pages[end - 1] + kPageSize) {
+      ++end;
+    }
+    memory.movb(i * kPageSize, pages[i], (end - i) * kPageSize);
+    i = end;
+  }
+
+  // Trace state, then the page table manager's
+  const Record &last = records.back();
+  const uint32_t *next = last.state;
+  const uint32_t *end = last.state + last.header->state_words;
+  TraceState state;
+  state.line_number = Take64(next, end);
+  state.offset = Take64(next, end);
+  if (next == end) throw std::runtime_error("checkpoint state is truncated");
+  state.record = *next++;
+  state.user_psw0 = Take64(next, end);
+  if (next == end) throw std::runtime_error("checkpoint state is truncated");
+  uint32_t process_count = *next++;
+  for (uint32_t i = 0; i < process_count; ++i) {
+    state.process_psw0s.push_back(Take64(next, end));
+  }
+  pt_manager.RestoreState(next, end);
+  return state;
+}
@@ -0,0 +1,127 @@
+/*
+ * File:   Checkpoint.h
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "ManagePageTable.h"
+
+#include <MMU.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Checkpoint image file: a sequence of records, each a complete machine
+ * state (all fields native-endian):
+ *
+ *   header:  magic "CKPT", version, frame count, page count,
+ *            state word count (uint64_t), record length (uint64_t)
+ *   state:   trace position and PSW0s, then the page table manager's host
+ *            state (see ManagePageTable::SaveState), as uint32_t words,
+ *            padded to keep records 8 byte aligned
+ *   pages:   page count frame numbers (uint32_t), then the contents of
+ *            those frames, kPageSize bytes each
+ *
+ * The first record holds every page frame. Each later record holds only
+ * the frames whose contents changed since the record before, so the
+ * memory of a record is the first record's with each later one applied in
+ * turn. Physical memory includes the allocator's bit map and free count
+ * and all page tables. A record cut short when the run stopped is ignored.
+ */
+class Checkpoint {
+public:
+  // Format version written to and required in each record
+  static const uint32_t kVersion = 1;
+
+  // Trace state saved with the machine
+  struct TraceState {
+    long line_number = 0;                 // line of the checkpoint
+    uint64_t offset = 0;                  // trace file offset of the next line,
+                                          //   or of the next compiled record
+    uint32_t record = 0;                  // number of the next compiled record
+    mem::PSW user_psw0 = 0;               // address space commands run in
+    std::vector<mem::PSW> process_psw0s;  // all address spaces, by process
+  };
+
+  /**
+   * Constructor - open an image file for writing checkpoints
+   *
+   * @param file_name_ image file; created, or truncated unless append
+   * @param memory_ MMU whose memory is saved
+   * @param pt_manager_ page table manager whose host state is saved
+   * @param append if true, memory was just restored from this file by
+   *   Restore; records are added after its last complete record, and the
+   *   first only holds frames changed since. Must then be called in kernel
+   *   mode.
+   * @throws std::runtime_error if the file can not be opened
+   */
+  Checkpoint(const std::string &file_name_, mem::MMU &memory_,
+             ManagePageTable &pt_manager_, bool append = false);
+
+  /**
+   * Destructor - close the image file
+   */
+  virtual ~Checkpoint(void);
+
+  // Disallow copy/move
+  Checkpoint(const Checkpoint &other) = delete;
+  Checkpoint(Checkpoint &&other) = delete;
+  Checkpoint &operator=(const Checkpoint &other) = delete;
+  Checkpoint &operator=(Checkpoint &&other) = delete;
+
+  /**
+   * Write - append a record of memory, the page table manager's host state
+   *   and the trace state, and flush it to disk. Must be called in kernel
+   *   mode with the kernel lock held.
+   *
+   * @param state trace state to save
+   * @throws std::runtime_error if the file can not be written, or the
+   *   page table manager state can not be saved
+   */
+  void Write(const TraceState &state);
+
+  /**
+   * Restore - map an image file and restore memory and the page table
+   *   manager's host state from its last complete record. Must be called
+   *   in kernel mode, before any process runs.
+   *
+   * @param file_name image file
+   * @param memory MMU to restore; must be the size saved
+   * @param pt_manager page table manager to restore
+   * @return trace state of the record
+   * @throws std::runtime_error if the file can not be mapped or has no
+   *   complete record for this memory size
+   */
+  static TraceState Restore(const std::string &file_name, mem::MMU &memory,
+                            ManagePageTable &pt_manager);
+
+  // Records written, and page frames written in them
+  uint64_t get_record_count(void) const { return record_count; }
+  uint64_t get_page_count(void) const { return page_count; }
+
+private:
+  std::string file_name;
+  mem::MMU &memory;
+  ManagePageTable &pt_manager;
+  int fd;
+
+  // Memory as of the last record; empty until a record has been written
+  // or restored
+  std::vector<uint8_t> saved;
+
+  uint64_t record_count;
+  uint64_t page_count;
+
+  /**
+   * WriteAll - write bytes at the end of the image file
+   * @throws std::runtime_error on an I/O error
+   */
+  void WriteAll(const void *data, size_t length);
+};
+
+#endif /* CHECKPOINT_H */
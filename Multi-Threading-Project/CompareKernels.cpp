@@ -0,0 +1,202 @@
+/*
+ * File:   CompareKernels.cpp
+ *
+ * Created on October 17, 2026
+ */
+
+#include "CompareKernels.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#define COMPARE_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace compare {
+namespace {
+  // Scalar kernels, also used for the tails of vector kernels
+
+  size_t FindNotEqualScalar(const uint8_t *bytes, size_t count, uint8_t value) {
+    for (size_t i = 0; i < count; ++i) {
+      if (bytes[i] != value) return i;
+    }
+    return count;
+  }
+
+  size_t FindDifferentScalar(const uint8_t *bytes, const uint8_t *expected, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      if (bytes[i] != expected[i]) return i;
+    }
+    return count;
+  }
+
+  bool NarrowScalar(const uint32_t *values, size_t count, uint8_t *bytes) {
+    for (size_t i = 0; i < count; ++i) {
+      if (values[i] > 0xFF) return false;
+      bytes[i] = values[i];
+    }
+    return true;
+  }
+
+#ifdef COMPARE_KERNELS_X86
+  // Index of the first zero bit of a compare mask with all bits of a full
+  // match set
+  inline size_t FirstClear(uint32_t mask) {
+    return __builtin_ctz(~mask);
+  }
+
+  // SSE2: 64 bytes per iteration, checked with one movemask
+
+  __attribute__((target("sse2")))
+  size_t FindNotEqualSse2(const uint8_t *bytes, size_t count, uint8_t value) {
+    const __m128i expected = _mm_set1_epi8(static_cast<char>(value));
+    size_t i = 0;
+    for (; i + 64 <= count; i += 64) {
+      const __m128i *p = reinterpret_cast<const __m128i *>(bytes + i);
+      __m128i all = _mm_and_si128(
+              _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(p), expected),
+                            _mm_cmpeq_epi8(_mm_loadu_si128(p + 1), expected)),
+              _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(p + 2), expected),
+                            _mm_cmpeq_epi8(_mm_loadu_si128(p + 3), expected)));
+      if (_mm_movemask_epi8(all) != 0xFFFF) break;
+    }
+    for (; i + 16 <= count; i += 16) {
+      __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i));
+      uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(data, expected));
+      if (mask != 0xFFFF) return i + FirstClear(mask);
+    }
+    return i + FindNotEqualScalar(bytes + i, count - i, value);
+  }
+
+  __attribute__((target("sse2")))
+  size_t FindDifferentSse2(const uint8_t *bytes, const uint8_t *expected, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i));
+      __m128i want = _mm_loadu_si128(reinterpret_cast<const __m128i *>(expected + i));
+      uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(data, want));
+      if (mask != 0xFFFF) return i + FirstClear(mask);
+    }
+    return i + FindDifferentScalar(bytes + i, expected + i, count - i);
+  }
+
+  // 16 values per iteration: saturating packs give the low bytes once no
+  // value has bits above the low byte
+  __attribute__((target("sse2")))
+  bool NarrowSse2(const uint32_t *values, size_t count, uint8_t *bytes) {
+    const __m128i high_bits = _mm_set1_epi32(~0xFF);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      const __m128i *p = reinterpret_cast<const __m128i *>(values + i);
+      __m128i v0 = _mm_loadu_si128(p);
+      __m128i v1 = _mm_loadu_si128(p + 1);
+      __m128i v2 = _mm_loadu_si128(p + 2);
+      __m128i v3 = _mm_loadu_si128(p + 3);
+      __m128i high = _mm_and_si128(_mm_or_si128(_mm_or_si128(v0, v1), _mm_or_si128(v2, v3)),
+                                   high_bits);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi32(high, _mm_setzero_si128())) != 0xFFFF) {
+        return false;
+      }
+      __m128i packed = _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(bytes + i), packed);
+    }
+    return NarrowScalar(values + i, count - i, bytes + i);
+  }
+
+  // AVX2: 128 bytes per iteration, checked with one movemask. Tails are
+  // scalar: calling the non-VEX SSE2 kernels here would pay an AVX-SSE
+  // transition on every call
+
+  __attribute__((target("avx2")))
+  size_t FindNotEqualAvx2(const uint8_t *bytes, size_t count, uint8_t value) {
+    const __m256i expected = _mm256_set1_epi8(static_cast<char>(value));
+    size_t i = 0;
+    for (; i + 128 <= count; i += 128) {
+      const __m256i *p = reinterpret_cast<const __m256i *>(bytes + i);
+      __m256i all = _mm256_and_si256(
+              _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256(p), expected),
+                               _mm256_cmpeq_epi8(_mm256_loadu_si256(p + 1), expected)),
+              _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256(p + 2), expected),
+                               _mm256_cmpeq_epi8(_mm256_loadu_si256(p + 3), expected)));
+      if (static_cast<uint32_t>(_mm256_movemask_epi8(all)) != 0xFFFFFFFF) break;
+    }
+    for (; i + 32 <= count; i += 32) {
+      __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes + i));
+      uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(data, expected));
+      if (mask != 0xFFFFFFFF) return i + FirstClear(mask);
+    }
+    return i + FindNotEqualScalar(bytes + i, count - i, value);
+  }
+
+  __attribute__((target("avx2")))
+  size_t FindDifferentAvx2(const uint8_t *bytes, const uint8_t *expected, size_t count) {
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+      __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes + i));
+      __m256i want = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(expected + i));
+      uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(data, want));
+      if (mask != 0xFFFFFFFF) return i + FirstClear(mask);
+    }
+    return i + FindDifferentScalar(bytes + i, expected + i, count - i);
+  }
+#endif
+
+  struct Kernels {
+    Kernel kernel;
+    size_t (*find_not_equal)(const uint8_t *, size_t, uint8_t);
+    size_t (*find_different)(const uint8_t *, const uint8_t *, size_t);
+    bool (*narrow)(const uint32_t *, size_t, uint8_t *);
+  };
+
+  Kernels KernelsFor(Kernel kernel) {
+    switch (kernel) {
+#ifdef COMPARE_KERNELS_X86
+      case Kernel::kAvx2:
+        return Kernels{ kernel, FindNotEqualAvx2, FindDifferentAvx2, NarrowSse2 };
+      case Kernel::kSse2:
+        return Kernels{ kernel, FindNotEqualSse2, FindDifferentSse2, NarrowSse2 };
+#endif
+      default:
+        return Kernels{ Kernel::kScalar, FindNotEqualScalar, FindDifferentScalar, NarrowScalar };
+    }
+  }
+
+  Kernels selected = KernelsFor(Best());
+}
+
+Kernel Best(void) {
+#ifdef COMPARE_KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return Kernel::kAvx2;
+  if (__builtin_cpu_supports("sse2")) return Kernel::kSse2;
+#endif
+  return Kernel::kScalar;
+}
+
+void Select(Kernel kernel) {
+  selected = KernelsFor(kernel);
+}
+
+Kernel Selected(void) {
+  return selected.kernel;
+}
+
+const char *Name(Kernel kernel) {
+  switch (kernel) {
+    case Kernel::kAvx2: return "avx2";
+    case Kernel::kSse2: return "sse2";
+    default: return "scalar";
+  }
+}
+
+size_t FindNotEqual(const uint8_t *bytes, size_t count, uint8_t value) {
+  return selected.find_not_equal(bytes, count, value);
+}
+
+size_t FindDifferent(const uint8_t *bytes, const uint8_t *expected, size_t count) {
+  return selected.find_different(bytes, expected, count);
+}
+
+bool Narrow(const uint32_t *values, size_t count, uint8_t *bytes) {
+  return selected.narrow(values, count, bytes);
+}
+}
@@ -0,0 +1,77 @@
+/*
+ * File:   CompareKernels.h
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef COMPAREKERNELS_H
+#define COMPAREKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Byte compare kernels for CBA and CB1. Each finds the first mismatch in a
+ * buffer, so a range that matches, the normal case, is checked 16 (SSE2) or
+ * 32 (AVX2) bytes per instruction, and the caller only goes byte by byte to
+ * report mismatches. The widest kernel the CPU supports is selected when
+ * the program starts; the scalar kernel is used on other architectures.
+ */
+namespace compare {
+  enum class Kernel { kScalar, kSse2, kAvx2 };
+
+  /**
+   * Best - widest kernel this CPU supports
+   */
+  Kernel Best(void);
+
+  /**
+   * Select - use a kernel from now on (benchmarks compare kernels this way)
+   *
+   * @param kernel kernel to use; must be supported (no wider than Best())
+   */
+  void Select(Kernel kernel);
+
+  /**
+   * Selected - kernel in use
+   */
+  Kernel Selected(void);
+
+  /**
+   * Name - name of a kernel ("scalar", "sse2", "avx2")
+   */
+  const char *Name(Kernel kernel);
+
+  /**
+   * FindNotEqual - find the first byte not equal to value
+   *
+   * @param bytes bytes to check
+   * @param count number of bytes
+   * @param value expected value of every byte
+   * @return index of the first mismatch, count if all match
+   */
+  size_t FindNotEqual(const uint8_t *bytes, size_t count, uint8_t value);
+
+  /**
+   * FindDifferent - find the first byte that differs between two buffers
+   *
+   * @param bytes bytes to check
+   * @param expected expected bytes
+   * @param count number of bytes
+   * @return index of the first difference, count if all match
+   */
+  size_t FindDifferent(const uint8_t *bytes, const uint8_t *expected, size_t count);
+
+  /**
+   * Narrow - convert 32 bit expected values (from CB1 operands) to bytes
+   *
+   * @param values values to convert
+   * @param count number of values
+   * @param bytes returns the low byte of each value
+   * @return true if every value fits in a byte; otherwise bytes is
+   *   incomplete and the values must be compared one at a time
+   */
+  bool Narrow(const uint32_t *values, size_t count, uint8_t *bytes);
+}
+
+#endif /* COMPAREKERNELS_H */
@@ -0,0 +1,164 @@
+/*
+ * File:   CompiledTrace.cpp
+ *
+ * Created on October 17, 2026
+ */
+
+#include "CompiledTrace.h"
+#include "Trace.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  // Header fields
+  const char kMagic[4] = { 'T', 'R', 'C', 'B' };
+  const size_t kHeaderWords = 4;
+  const size_t kRecordCountWord = 2;
+
+  // Fixed words at the start of each record
+  const size_t kRecordWords = 4;
+
+  // Number of words needed to hold bytes, rounded up
+  size_t WordsFor(size_t bytes) {
+    return (bytes + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+  }
+
+  void WriteWord(std::ofstream &out, uint32_t word) {
+    out.write(reinterpret_cast<const char *>(&word), sizeof(word));
+  }
+}
+
+void CompiledTrace::Compile(const std::string &text_file_name,
+                            const std::string &binary_file_name) {
+  std::ifstream in(text_file_name);
+  if (!in.is_open()) {
+    throw std::runtime_error("failed to open trace file: " + text_file_name);
+  }
+  std::ofstream out(binary_file_name, std::ios_base::binary | std::ios_base::trunc);
+  if (!out.is_open()) {
+    throw std::runtime_error("failed to create compiled trace: " + binary_file_name);
+  }
+
+  // Header; record count is filled in at the end
+  uint32_t magic;
+  std::memcpy(&magic, kMagic, sizeof(magic));
+  WriteWord(out, magic);
+  WriteWord(out, kVersion);
+  WriteWord(out, 0);
+  WriteWord(out, 0);
+
+  std::string textLine;
+  std::vector<uint32_t> hexVals;
+  uint32_t line_number = 0;
+  while (std::getline(in, textLine)) {
+    ++line_number;
+    Trace::ParseLine(textLine.data(), textLine.data() + textLine.size(), hexVals);
+
+    WriteWord(out, line_number);
+    WriteWord(out, hexVals[0]);
+    WriteWord(out, hexVals.size() - 1);
+    WriteWord(out, textLine.size());
+    for (size_t i = 1; i < hexVals.size(); ++i) {
+      WriteWord(out, hexVals[i]);
+    }
+    textLine.resize(WordsFor(textLine.size()) * sizeof(uint32_t), '\0');
+    out.write(textLine.data(), textLine.size());
+  }
+  if (!in.eof()) {
+    throw std::runtime_error("getline failed on trace file: " + text_file_name);
+  }
+
+  out.seekp(kRecordCountWord * sizeof(uint32_t));
+  WriteWord(out, line_number);
+  out.close();
+  if (out.fail()) {
+    throw std::runtime_error("failed to write compiled trace: " + binary_file_name);
+  }
+}
+
+bool CompiledTrace::IsCompiled(const std::string &file_name) {
+  std::ifstream in(file_name, std::ios_base::binary);
+  char magic[sizeof(kMagic)];
+  if (!in.read(magic, sizeof(magic))) return false;
+  return std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+CompiledTrace::CompiledTrace(const std::string &file_name)
+: words(nullptr), word_count(0), map_length(0), record_count(0),
+  next_record(0), next_word(kHeaderWords)
+{
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("failed to open compiled trace: " + file_name);
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0
+          || file_stat.st_size < static_cast<off_t>(kHeaderWords * sizeof(uint32_t))) {
+    close(fd);
+    throw std::runtime_error("invalid compiled trace: " + file_name);
+  }
+
+  // Map read-only; the mapping remains valid after the descriptor is closed
+  map_length = file_stat.st_size;
+  void *map = mmap(nullptr, map_length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    throw std::runtime_error("failed to map compiled trace: " + file_name);
+  }
+  madvise(map, map_length, MADV_SEQUENTIAL);
+  words = static_cast<const uint32_t *>(map);
+  word_count = map_length / sizeof(uint32_t);
+
+  if (std::memcmp(words, kMagic, sizeof(kMagic)) != 0 || words[1] != kVersion) {
+    munmap(map, map_length);
+    throw std::runtime_error("unsupported compiled trace version: " + file_name);
+  }
+  record_count = words[kRecordCountWord];
+}
+
+CompiledTrace::~CompiledTrace(void) {
+  munmap(const_cast<uint32_t *>(words), map_length);
+}
+
+bool CompiledTrace::Next(long &line_number, const char *&text,
+                         uint32_t &text_length, std::vector<uint32_t> &hexVals) {
+  if (next_record >= record_count) return false;
+
+  if (next_word + kRecordWords > word_count) {
+    throw std::runtime_error("truncated compiled trace");
+  }
+  const uint32_t *record = words + next_word;
+  uint32_t operand_count = record[2];
+  text_length = record[3];
+  size_t length = kRecordWords + operand_count + WordsFor(text_length);
+  if (length > word_count - next_word) {
+    throw std::runtime_error("truncated compiled trace");
+  }
+
+  line_number = record[0];
+  hexVals.clear();
+  hexVals.push_back(record[1]);
+  hexVals.insert(hexVals.end(), record + kRecordWords,
+                 record + kRecordWords + operand_count);
+  text = reinterpret_cast<const char *>(record + kRecordWords + operand_count);
+
+  next_word += length;
+  ++next_record;
+  return true;
+}
+
+void CompiledTrace::Seek(uint64_t offset, uint32_t record) {
+  if (offset % sizeof(uint32_t) != 0 || offset / sizeof(uint32_t) < kHeaderWords
+          || offset / sizeof(uint32_t) > word_count || record > record_count) {
+    throw std::runtime_error("compiled trace position out of range");
+  }
+  next_word = offset / sizeof(uint32_t);
+  next_record = record;
+}
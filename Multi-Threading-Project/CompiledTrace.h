@@ -0,0 +1,107 @@
+/*
+ * File:   CompiledTrace.h
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef COMPILEDTRACE_H
+#define COMPILEDTRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Binary trace file layout (all fields native-endian uint32_t):
+ *
+ *   header:  magic "TRCB", version, record count, reserved
+ *   record:  line number, command code, operand count, text length,
+ *            operands[operand count], text bytes padded to 4 bytes
+ *
+ * The original line text is kept so that replay echoes exactly what the
+ * text trace would.
+ */
+class CompiledTrace {
+public:
+  // Format version written to and required in the header
+  static const uint32_t kVersion = 1;
+
+  /**
+   * Compile - translate a text trace file to the binary format
+   *
+   * @param text_file_name source trace file
+   * @param binary_file_name file to create
+   * @throws std::runtime_error if either file can't be read or written
+   */
+  static void Compile(const std::string &text_file_name,
+                      const std::string &binary_file_name);
+
+  /**
+   * IsCompiled - check whether a file starts with the binary trace magic
+   *
+   * @param file_name file to check
+   * @return true if the file is a compiled trace
+   */
+  static bool IsCompiled(const std::string &file_name);
+
+  /**
+   * Constructor - map compiled trace file into memory
+   *
+   * @param file_name compiled trace file
+   * @throws std::runtime_error if the file can't be mapped or is invalid
+   */
+  CompiledTrace(const std::string &file_name);
+
+  /**
+   * Destructor - unmap file
+   */
+  virtual ~CompiledTrace(void);
+
+  // Disallow copy/move
+  CompiledTrace(const CompiledTrace &other) = delete;
+  CompiledTrace(CompiledTrace &&other) = delete;
+  CompiledTrace &operator=(const CompiledTrace &other) = delete;
+  CompiledTrace &operator=(CompiledTrace &&other) = delete;
+
+  /**
+   * Next - decode the next record
+   *
+   * @param line_number returns the line number in the original text trace
+   * @param text returns pointer to the original line text (not terminated)
+   * @param text_length returns length of the line text
+   * @param hexVals returns command code followed by the operands
+   * @return true if a record was decoded, false at end of file
+   * @throws std::runtime_error if the record runs past the end of the file
+   */
+  bool Next(long &line_number, const char *&text, uint32_t &text_length,
+            std::vector<uint32_t> &hexVals);
+
+  // Position of the next record: its byte offset in the file and number
+  uint64_t get_offset(void) const { return next_word * sizeof(uint32_t); }
+  uint32_t get_record(void) const { return next_record; }
+
+  /**
+   * Seek - continue decoding at a position returned by get_offset and
+   *   get_record (when resuming from a checkpoint)
+   *
+   * @param offset byte offset of the next record
+   * @param record number of the next record
+   * @throws std::runtime_error if the position is outside the file
+   */
+  void Seek(uint64_t offset, uint32_t record);
+
+private:
+  // Record counts and mapping
+  const uint32_t *words;
+  size_t word_count;
+  size_t map_length;
+  uint32_t record_count;
+
+  // Next record to decode
+  uint32_t next_record;
+  size_t next_word;
+};
+
+#endif /* COMPILEDTRACE_H */
+
@@ -0,0 +1,69 @@
+/*
+ * File:   KernelLock.h
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef KERNELLOCK_H
+#define KERNELLOCK_H
+
+#include <mutex>
+
+/*
+ * KernelLock - serializes processes sharing one MMU, allocator and page
+ * table manager.
+ *
+ * The MMU has a single mode, user PSW0 and set of fault handlers, so a
+ * process must hold the lock from loading its context until its memory
+ * access or kernel call completes. The lock remembers which process's
+ * context is loaded so that it is only reloaded on a switch.
+ *
+ * The lock is recursive, so kernel code called with it held (such as a
+ * concurrent BitMapAllocator) can take it again for its own MMU accesses.
+ */
+class KernelLock {
+public:
+  KernelLock() : owner(nullptr) {}
+
+  virtual ~KernelLock() {}  // empty destructor
+
+  // Disallow copy/move
+  KernelLock(const KernelLock &other) = delete;
+  KernelLock(KernelLock &&other) = delete;
+  KernelLock &operator=(const KernelLock &other) = delete;
+  KernelLock &operator=(KernelLock &&other) = delete;
+
+  /**
+   * Acquire - lock the kernel for a process
+   *
+   * @param process identifies the calling process
+   * @param switched returns true if another process (or none) ran last, so
+   *   the caller must load its context into the MMU
+   * @return lock, released when destroyed
+   */
+  std::unique_lock<std::recursive_mutex> Acquire(const void *process, bool &switched) {
+    std::unique_lock<std::recursive_mutex> lock(mutex);
+    switched = (owner != process);
+    owner = process;
+    return lock;
+  }
+
+  /**
+   * Acquire - lock the kernel for kernel-mode MMU accesses that leave the
+   *   loaded process context (user PSW0, fault handlers) unchanged
+   *
+   * @return lock, released when destroyed
+   */
+  std::unique_lock<std::recursive_mutex> Acquire(void) {
+    return std::unique_lock<std::recursive_mutex>(mutex);
+  }
+
+private:
+  std::recursive_mutex mutex;
+
+  // Process whose context is loaded in the MMU
+  const void *owner;
+};
+
+#endif /* KERNELLOCK_H */
+
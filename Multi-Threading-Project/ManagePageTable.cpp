@@ -5,9 +5,36 @@
  */
 
 #include "ManagePageTable.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
 
-ManagePageTable::ManagePageTable(mem::MMU &memory_, BitMapAllocator &allocator_): memory(memory_), allocator(allocator_){
+const uint8_t ManagePageTable::kPageNormal;
+const uint8_t ManagePageTable::kReservedWritable;
+const uint8_t ManagePageTable::kReservedReadOnly;
+const uint8_t ManagePageTable::kCopyOnWrite;
+const uint8_t ManagePageTable::kSwapClean;
+const uint8_t ManagePageTable::kSwappedWritable;
+const uint8_t ManagePageTable::kSwappedReadOnly;
+
+namespace {
+    // Kernel address of a process page table
+    mem::Addr PageTableBase(mem::PSW psw0) {
+        return ((psw0 >> mem::kPSW0_PageTableShift) & mem::kPSW0_PageTableMask) << mem::kPageSizeBits;
+    }
+}
+
+ManagePageTable::ManagePageTable(mem::MMU &memory_, BitMapAllocator &allocator_): memory(memory_), allocator(allocator_),
+        frame_refs(memory_.get_frame_count(), 0), swap(nullptr), clock_hand(0){
+    //a kernel page table has one entry per frame it maps; with more
+    //memory the kernel stays in physical mode, which addresses every
+    //frame at the same address a full kernel page table would
+    mem::PageTable page_table;
+    if(memory.get_frame_count() > page_table.size()){
+        return;
+    }
+    
     //virtual memory 
     std::vector<mem::Addr> page_frames;
     mem::Addr kernel_pt_addr;
@@ -17,7 +44,6 @@ ManagePageTable::ManagePageTable(mem::MMU &memory_, BitMapAllocator &allocator_)
         kernel_pt_addr = page_frames.at(0);
         
         // Build page table entries (map to end of existing memory)
-        mem::PageTable page_table;
         mem::Addr num_pages = memory.get_frame_count();
         
         for(mem::Addr i = 0; i < num_pages; ++i){
@@ -35,49 +61,62 @@ ManagePageTable::ManagePageTable(mem::MMU &memory_, BitMapAllocator &allocator_)
     }
 }
 
-void ManagePageTable::MapProcessPages(mem::PSW psw0, mem::Addr vaddr, size_t count){
+void ManagePageTable::MapProcessPages(mem::PSW psw0, mem::Addr vaddr, size_t count,
+        bool contiguous){
+    mem::Addr pt_base = PageTableBase(psw0);
+    mem::Addr first_index = vaddr >> mem::kPageSizeBits;
+    std::vector<uint8_t> &states = Pages(pt_base).states;
+    
+    // Count pages needing a frame; those mapped or swapped out are ignored
+    std::vector<mem::PageTableEntry> entries(count);
+    ReadEntries(pt_base, first_index, entries);
+    uint32_t needed = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t state = states.at(first_index + i);
+        if ((entries[i] & mem::kPTE_PresentMask) == 0
+                && state != kSwappedWritable && state != kSwappedReadOnly) {
+            ++needed;
+        }
+    }
+    if (needed == 0) {
+        return;
+    }
+    
     // Allocate count number of pages, use GetFrames!
     std::vector<mem::Addr> page_frames;
-    if(allocator.GetFrames(count, page_frames)){
-        // Map the allocated pages
-        mem::Addr next_vaddr = vaddr;
-
-        //First calculate the base:
-        mem::Addr pt_base = ((psw0 >> mem::kPSW0_PageTableShift) & mem::kPSW0_PageTableMask) << mem::kPageSizeBits;
-        //calculate the current index:
-        while (count-- > 0) { //START WHILE LOOP
-
-            mem::Addr pt_index = next_vaddr >> mem::kPageSizeBits;
-
-            // Read existing page table entry
-            mem::PageTableEntry pt_entry;
-
-            //set the address to the base + the index times the size of a pagetableentry
-            mem::Addr pte_addr = pt_base + (pt_index * sizeof(pt_entry));
-                    //Use moveb to read from this pte address in memory to your pagetableentry object
-            memory.movb(&pt_entry, pte_addr, sizeof(pt_entry));
-                    // If page not mapped, create and write page table entry
-            if ((pt_entry & mem::kPTE_PresentMask) == 0) {
-                pt_entry = page_frames.back() | mem::kPTE_PresentMask | mem::kPTE_WritableMask;//get the last entry in the allocated vector and mask it with present and writable
-                //pop to make page_frames.back() valid for next iteration
-                page_frames.pop_back();
-                        //Then store it into memory by using moveb
-                memory.movb(pte_addr, &pt_entry, sizeof(pt_entry));
-            }
-
-            //set the next address
-            next_vaddr += mem::kPageSize;
-        } //END WHILE LOOP
-
-        // Release any left over page frames (if some were already mapped)
-        //If allocator vector not empty, use FreeFrames on the remaining pageframes in the vector
-        if(!page_frames.empty()){
-            allocator.FreeFrames(page_frames.size(), page_frames);
+    if (!(contiguous && allocator.GetContiguousFrames(needed, 1, page_frames))
+            && !AllocateFrames(needed, page_frames)) {
+        //with swap, a region larger than memory is mapped in pieces that fit
+        if (swap == nullptr || count == 1) {
+            throw std::runtime_error("Error: could not allocate Process Pages");
+        }
+        size_t half = count / 2;
+        MapProcessPages(psw0, vaddr, half, contiguous);
+        MapProcessPages(psw0, vaddr + half * mem::kPageSize, count - half, contiguous);
+        return;
+    }
+    if (swap != nullptr) {
+        ReadEntries(pt_base, first_index, entries);  // eviction may have changed them
+    }
+    
+    // Map the allocated pages in order, then write the span back at once
+    std::vector<size_t> mapped;
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t &state = states[first_index + i];
+        if ((entries[i] & mem::kPTE_PresentMask) == 0
+                && state != kSwappedWritable && state != kSwappedReadOnly) {
+            entries[i] = page_frames[mapped.size()] | mem::kPTE_PresentMask | mem::kPTE_WritableMask;
+            frame_refs.at(entries[i] >> mem::kPageSizeBits) = 1;
+            state = kPageNormal;
+            mapped.push_back(i);
         }
-    }else{
-        throw std::runtime_error("Error: could not allocate Process Pages");
     }
+    WriteEntries(pt_base, first_index, entries);
     
+    for (size_t i : mapped) {
+        tlb.Invalidate(pt_base, vaddr + i * mem::kPageSize);
+        AddResident(pt_base, vaddr + i * mem::kPageSize);
+    }
 }
 
 mem::Addr ManagePageTable::CreateProcessPageTable(){
@@ -85,52 +124,507 @@ mem::Addr ManagePageTable::CreateProcessPageTable(){
     mem::Addr pt_page_table;
     mem::PageTable page_table;
     
-    if(allocator.GetFrames(1, page_frames)){
+    if(AllocateFrames(1, page_frames)){
         pt_page_table = page_frames.at(0);
+        page_table.fill(0); //all entries not present
         memory.movb(pt_page_table, &page_table, mem::kPageTableSizeBytes);
+        tlb.InvalidateAll(pt_page_table);
+        process_pages.erase(pt_page_table);
         return pt_page_table;
     }else{
-        std::cerr << "Error: could not create process page table";
+        throw std::runtime_error("Error: could not create process page table");
     }
 }
 
 void ManagePageTable::SetPageWritePermission(mem::PSW psw0, mem::Addr vaddr, size_t count, uint32_t writable){
-    std::vector<mem::Addr> page_frames;
+    mem::Addr pt_base = PageTableBase(psw0);
+    mem::Addr first_index = vaddr >> mem::kPageSizeBits;
+    ProcessPages &pages = Pages(pt_base);
+    std::vector<uint8_t> &states = pages.states;
     
-    if(allocator.GetFrames(count, page_frames)){
-        
-        mem::Addr pt_base = ((psw0 >> mem::kPSW0_PageTableShift) & mem::kPSW0_PageTableMask) << mem::kPageSizeBits;
-        mem::Addr pt_index = vaddr >> mem::kPageSizeBits;
-        mem::Addr next_vaddr = vaddr;
-        
-        while(count-- > 0){
-            mem::PageTableEntry pt_entry;
-            
-            mem::Addr pt_index = next_vaddr >> mem::kPageSizeBits;
-            
-            mem::Addr pte_addr = pt_base + (pt_index * sizeof (pt_entry));
-
-            memory.movb(&pt_entry, pte_addr, sizeof (pt_entry));
-            
-            //check to see if mapped
-            if ((pt_entry & mem::kPTE_PresentMask) != 0) {
-                
-                if(writable != 0){
-                    //enable the 5th bit of page entry
-                    pt_entry = (pt_entry & ~mem::kPTE_WritableMask)  | mem::kPTE_WritableMask;
-                }else {
-                    //disable the 5th bit of page entry with 0
-                    pt_entry = pt_entry & ~mem::kPTE_WritableMask;
-                }
-                
-                memory.movb(pte_addr, &pt_entry, sizeof(pt_entry));
+    // Update the span in a host copy and write it back at once
+    std::vector<mem::PageTableEntry> entries(count);
+    ReadEntries(pt_base, first_index, entries);
+    for (size_t i = 0; i < count; ++i) {
+        mem::Addr pt_index = first_index + i;
+        mem::PageTableEntry &pt_entry = entries[i];
+        
+        //a reserved or swapped page takes the permission when mapped
+        if ((pt_entry & mem::kPTE_PresentMask) == 0) {
+            if (states.at(pt_index) == kReservedWritable
+                    || states.at(pt_index) == kReservedReadOnly) {
+                states.at(pt_index) =
+                        (writable != 0) ? kReservedWritable : kReservedReadOnly;
+            } else if (states.at(pt_index) != kPageNormal) {
+                states.at(pt_index) =
+                        (writable != 0) ? kSwappedWritable : kSwappedReadOnly;
             }
-            next_vaddr += mem::kPageSize;
+            continue;
         }
-    }else {
+        
+        if(writable != 0 && frame_refs.at(pt_entry >> mem::kPageSizeBits) > 1){
+            //shared: copy on the first write
+            states.at(pt_index) = kCopyOnWrite;
+        }else if(writable != 0 && pages.swap_slots.at(pt_index) != SwapSpace::kNoSlot){
+            //clean: stays read-only to catch the first write
+            states.at(pt_index) = kSwapClean;
+        }else if(writable != 0){
+            states.at(pt_index) = kPageNormal;
+            //enable the 5th bit of page entry
+            pt_entry = (pt_entry & ~mem::kPTE_WritableMask)  | mem::kPTE_WritableMask;
+        }else {
+            //disable the 5th bit of page entry with 0
+            pt_entry = pt_entry & ~mem::kPTE_WritableMask;
+            states.at(pt_index) = kPageNormal;
+        }
+        tlb.Invalidate(pt_base, vaddr + i * mem::kPageSize);
+    }
+    WriteEntries(pt_base, first_index, entries);
+}
+
+void ManagePageTable::UnmapProcessPages(mem::PSW psw0, mem::Addr vaddr, size_t count){
+    std::vector<mem::Addr> free_frames;
+    ClearEntries(PageTableBase(psw0), vaddr >> mem::kPageSizeBits, count, free_frames);
+    allocator.FreeFrames(free_frames.size(), free_frames);
+}
+
+void ManagePageTable::DestroyProcessPageTable(mem::PSW psw0){
+    mem::Addr pt_base = PageTableBase(psw0);
+    std::vector<mem::Addr> free_frames;
+    ClearEntries(pt_base, 0, mem::kPageTableSizeBytes / sizeof(mem::PageTableEntry),
+            free_frames);
+    free_frames.push_back(pt_base);
+    allocator.FreeFrames(free_frames.size(), free_frames);
+    tlb.InvalidateAll(pt_base);
+    process_pages.erase(pt_base);
+}
+
+void ManagePageTable::ReserveProcessPages(mem::PSW psw0, mem::Addr vaddr, size_t count){
+    mem::Addr pt_base = ((psw0 >> mem::kPSW0_PageTableShift) & mem::kPSW0_PageTableMask) << mem::kPageSizeBits;
+    std::vector<uint8_t> &reserved = Pages(pt_base).states;
+    
+    mem::Addr next_vaddr = vaddr;
+    while (count-- > 0) {
+        mem::Addr pt_index = next_vaddr >> mem::kPageSizeBits;
+        mem::PageTableEntry pt_entry;
+        mem::Addr pte_addr = pt_base + (pt_index * sizeof(pt_entry));
+        memory.movb(&pt_entry, pte_addr, sizeof(pt_entry));
+        
+        // Pages already mapped or reserved are ignored
+        if ((pt_entry & mem::kPTE_PresentMask) == 0
+                && reserved.at(pt_index) == kPageNormal) {
+            reserved.at(pt_index) = kReservedWritable;
+        }
+        next_vaddr += mem::kPageSize;
+    }
+}
+
+bool ManagePageTable::MapReservedPage(mem::PSW psw0, mem::Addr vaddr){
+    mem::Addr pt_base = ((psw0 >> mem::kPSW0_PageTableShift) & mem::kPSW0_PageTableMask) << mem::kPageSizeBits;
+    mem::Addr pt_index = vaddr >> mem::kPageSizeBits;
+    auto reserved = process_pages.find(pt_base);
+    if (reserved == process_pages.end() || pt_index >= reserved->second.states.size()
+            || (reserved->second.states[pt_index] != kReservedWritable
+                && reserved->second.states[pt_index] != kReservedReadOnly)) {
+        return false;
+    }
+    
+    std::vector<mem::Addr> page_frames;
+    if (!AllocateFrames(1, page_frames)) {
         throw std::runtime_error("Error: could not allocate Process Pages");
     }
+    std::vector<uint8_t> &states = reserved->second.states;
+    mem::PageTableEntry pt_entry = page_frames[0] | mem::kPTE_PresentMask;
+    if (states[pt_index] == kReservedWritable) {
+        pt_entry |= mem::kPTE_WritableMask;
+    }
+    states[pt_index] = kPageNormal;
+    frame_refs.at(page_frames[0] >> mem::kPageSizeBits) = 1;
     
+    mem::Addr pte_addr = pt_base + (pt_index * sizeof(pt_entry));
+    memory.movb(pte_addr, &pt_entry, sizeof(pt_entry));
+    tlb.Invalidate(pt_base, vaddr);
+    AddResident(pt_base, vaddr);
+    return true;
 }
 
+mem::Addr ManagePageTable::ForkProcessPageTable(mem::PSW parent_psw0){
+    mem::Addr parent_base = PageTableBase(parent_psw0);
+    mem::Addr child_base = CreateProcessPageTable();
+    
+    mem::PageTable page_table;
+    memory.movb(&page_table, parent_base, mem::kPageTableSizeBytes);
+    ProcessPages &parent = Pages(parent_base);
+    
+    for(size_t i = 0; i < page_table.size(); ++i){
+        //swapped copies are shared too
+        if(parent.swap_slots[i] != SwapSpace::kNoSlot){
+            swap->AddRef(parent.swap_slots[i]);
+        }
+        
+        mem::PageTableEntry &pt_entry = page_table[i];
+        if((pt_entry & mem::kPTE_PresentMask) == 0){
+            continue;
+        }
+        ++frame_refs.at(pt_entry >> mem::kPageSizeBits);
+        
+        //share writable pages until the first write
+        if((pt_entry & mem::kPTE_WritableMask) != 0 || parent.states[i] == kSwapClean){
+            pt_entry &= ~mem::kPTE_WritableMask;
+            parent.states[i] = kCopyOnWrite;
+        }
+    }
+    
+    memory.movb(parent_base, &page_table, mem::kPageTableSizeBytes);
+    memory.movb(child_base, &page_table, mem::kPageTableSizeBytes);
+    tlb.InvalidateAll(parent_base);
+    ProcessPages &child = Pages(child_base);
+    child.states = parent.states;
+    child.swap_slots = parent.swap_slots;
+    for(size_t i = 0; i < page_table.size(); ++i){
+        if((page_table[i] & mem::kPTE_PresentMask) != 0){
+            AddResident(child_base, i << mem::kPageSizeBits);
+        }
+    }
+    return child_base;
+}
 
+bool ManagePageTable::CopyOnWrite(mem::PSW psw0, mem::Addr vaddr){
+    mem::Addr pt_base = PageTableBase(psw0);
+    mem::Addr pt_index = vaddr >> mem::kPageSizeBits;
+    auto pages = process_pages.find(pt_base);
+    if (pages == process_pages.end() || pt_index >= pages->second.states.size()
+            || pages->second.states[pt_index] != kCopyOnWrite) {
+        return false;
+    }
+    
+    mem::PageTableEntry pt_entry;
+    mem::Addr pte_addr = pt_base + (pt_index * sizeof(pt_entry));
+    memory.movb(&pt_entry, pte_addr, sizeof(pt_entry));
+    mem::Addr frame_addr = (pt_entry >> mem::kPageSizeBits) << mem::kPageSizeBits;
+    uint32_t frame_num = frame_addr >> mem::kPageSizeBits;
+    
+    if (frame_refs.at(frame_num) > 1) {
+        //allocate a frame for the copy; the frame copied from holds an extra
+        //reference meanwhile, so that evicting this page or the other
+        //mappings of the frame can not free it
+        std::vector<mem::Addr> page_frames;
+        ++frame_refs[frame_num];
+        bool allocated = AllocateFrames(1, page_frames);
+        if (--frame_refs[frame_num] == 0) {
+            std::vector<mem::Addr> free_frames(1, frame_addr);
+            allocator.FreeFrames(1, free_frames);
+        }
+        if (!allocated) {
+            throw std::runtime_error("Error: could not allocate Process Pages");
+        }
+        
+        //if this page was evicted, the retried write swaps it back in
+        if (pages->second.states[pt_index] != kCopyOnWrite) {
+            allocator.FreeFrames(1, page_frames);
+            return true;
+        }
+        memory.movb(&pt_entry, pte_addr, sizeof(pt_entry));
+        
+        //copy the page into a frame of its own, unless eviction left this
+        //the only mapping of the frame
+        if (frame_refs[frame_num] > 1) {
+            uint8_t bytes[mem::kPageSize];
+            memory.movb(bytes, frame_addr, mem::kPageSize);
+            memory.movb(page_frames[0], bytes, mem::kPageSize);
+            --frame_refs[frame_num];
+            frame_refs.at(page_frames[0] >> mem::kPageSizeBits) = 1;
+            pt_entry = (pt_entry & ((1u << mem::kPageSizeBits) - 1)) | page_frames[0];
+        } else {
+            allocator.FreeFrames(1, page_frames);
+        }
+    }
+    pt_entry |= mem::kPTE_WritableMask;
+    pages->second.states[pt_index] = kPageNormal;
+    ReleaseSwapSlot(pages->second, pt_index);  // about to be written
+    
+    memory.movb(pte_addr, &pt_entry, sizeof(pt_entry));
+    tlb.Invalidate(pt_base, vaddr);
+    return true;
+}
+
+void ManagePageTable::EnableSwap(SwapSpace &swap_){
+    swap = &swap_;
+}
+
+bool ManagePageTable::SwapIn(mem::PSW psw0, mem::Addr vaddr){
+    mem::Addr pt_base = PageTableBase(psw0);
+    mem::Addr pt_index = vaddr >> mem::kPageSizeBits;
+    auto pages = process_pages.find(pt_base);
+    if (pages == process_pages.end() || pt_index >= pages->second.states.size()
+            || (pages->second.states[pt_index] != kSwappedWritable
+                && pages->second.states[pt_index] != kSwappedReadOnly)) {
+        return false;
+    }
+    
+    std::vector<mem::Addr> page_frames;
+    if (!AllocateFrames(1, page_frames)) {
+        throw std::runtime_error("Error: could not allocate Process Pages");
+    }
+    uint8_t bytes[mem::kPageSize];
+    swap->Read(pages->second.swap_slots[pt_index], bytes);
+    memory.movb(page_frames[0], bytes, mem::kPageSize);
+    ++swap_stats.swap_ins;
+    
+    //read-only until the first write, so the slot stays a clean copy
+    uint8_t &state = pages->second.states[pt_index];
+    state = (state == kSwappedWritable) ? kSwapClean : kPageNormal;
+    mem::PageTableEntry pt_entry = page_frames[0] | mem::kPTE_PresentMask;
+    frame_refs.at(page_frames[0] >> mem::kPageSizeBits) = 1;
+    
+    mem::Addr pte_addr = pt_base + (pt_index * sizeof(pt_entry));
+    memory.movb(pte_addr, &pt_entry, sizeof(pt_entry));
+    tlb.Invalidate(pt_base, vaddr);
+    AddResident(pt_base, vaddr);
+    return true;
+}
+
+bool ManagePageTable::MarkDirty(mem::PSW psw0, mem::Addr vaddr){
+    mem::Addr pt_base = PageTableBase(psw0);
+    mem::Addr pt_index = vaddr >> mem::kPageSizeBits;
+    auto pages = process_pages.find(pt_base);
+    if (pages == process_pages.end() || pt_index >= pages->second.states.size()
+            || pages->second.states[pt_index] != kSwapClean) {
+        return false;
+    }
+    
+    mem::PageTableEntry pt_entry;
+    mem::Addr pte_addr = pt_base + (pt_index * sizeof(pt_entry));
+    memory.movb(&pt_entry, pte_addr, sizeof(pt_entry));
+    pt_entry |= mem::kPTE_WritableMask;
+    pages->second.states[pt_index] = kPageNormal;
+    ReleaseSwapSlot(pages->second, pt_index);
+    
+    memory.movb(pte_addr, &pt_entry, sizeof(pt_entry));
+    tlb.Invalidate(pt_base, vaddr);
+    return true;
+}
+
+void ManagePageTable::ClearEntries(mem::Addr pt_base, mem::Addr first_index, size_t count,
+        std::vector<mem::Addr> &free_frames){
+    ProcessPages &pages = Pages(pt_base);
+    std::vector<mem::PageTableEntry> entries(count);
+    ReadEntries(pt_base, first_index, entries);
+    
+    for (size_t i = 0; i < count; ++i) {
+        mem::Addr pt_index = first_index + i;
+        if ((entries[i] & mem::kPTE_PresentMask) != 0) {
+            //a frame shared after a fork stays with the other process
+            mem::Addr frame_num = entries[i] >> mem::kPageSizeBits;
+            if (--frame_refs.at(frame_num) == 0) {
+                free_frames.push_back(frame_num << mem::kPageSizeBits);
+            }
+            entries[i] = 0;
+            tlb.Invalidate(pt_base, pt_index << mem::kPageSizeBits);
+        }
+        pages.states.at(pt_index) = kPageNormal;
+        pages.referenced.at(pt_index) = 0;
+        ReleaseSwapSlot(pages, pt_index);
+    }
+    WriteEntries(pt_base, first_index, entries);
+    
+    //drop the pages from the clock
+    if (!resident_pages.empty()) {
+        mem::Addr first_vaddr = first_index << mem::kPageSizeBits;
+        mem::Addr end_vaddr = (first_index + count) << mem::kPageSizeBits;
+        resident_pages.erase(std::remove_if(resident_pages.begin(), resident_pages.end(),
+                [=](const ResidentPage &page) {
+                    return page.pt_base == pt_base
+                            && page.vaddr >= first_vaddr && page.vaddr < end_vaddr;
+                }), resident_pages.end());
+        if (clock_hand >= resident_pages.size()) {
+            clock_hand = 0;
+        }
+    }
+}
+
+void ManagePageTable::ReadEntries(mem::Addr pt_base, mem::Addr first_index,
+        std::vector<mem::PageTableEntry> &entries){
+    if (!entries.empty()) {
+        memory.movb(entries.data(), pt_base + first_index * sizeof(mem::PageTableEntry),
+                entries.size() * sizeof(mem::PageTableEntry));
+    }
+}
+
+void ManagePageTable::WriteEntries(mem::Addr pt_base, mem::Addr first_index,
+        const std::vector<mem::PageTableEntry> &entries){
+    if (!entries.empty()) {
+        memory.movb(pt_base + first_index * sizeof(mem::PageTableEntry), entries.data(),
+                entries.size() * sizeof(mem::PageTableEntry));
+    }
+}
+
+void ManagePageTable::SaveState(std::vector<uint32_t> &words) const{
+    if (swap != nullptr) {
+        throw std::runtime_error("checkpoints are not supported with swap");
+    }
+    
+    // Page states of each page table, 4 to a word
+    words.push_back(process_pages.size());
+    for (const auto &entry : process_pages) {
+        const std::vector<uint8_t> &states = entry.second.states;
+        words.push_back(entry.first);
+        size_t first = words.size();
+        words.resize(first + (states.size() + 3) / 4, 0);
+        memcpy(&words[first], states.data(), states.size());
+    }
+    words.push_back(frame_refs.size());
+    words.insert(words.end(), frame_refs.begin(), frame_refs.end());
+}
+
+void ManagePageTable::RestoreState(const uint32_t *&next, const uint32_t *end){
+    auto take = [&next, end](size_t count) {
+        if (static_cast<size_t>(end - next) < count) {
+            throw std::runtime_error("checkpoint state is truncated");
+        }
+        const uint32_t *words = next;
+        next += count;
+        return words;
+    };
+    
+    for (const auto &entry : process_pages) {
+        tlb.InvalidateAll(entry.first);
+    }
+    process_pages.clear();
+    uint32_t table_count = *take(1);
+    for (uint32_t i = 0; i < table_count; ++i) {
+        mem::Addr pt_base = *take(1);
+        std::vector<uint8_t> &states = Pages(pt_base).states;
+        memcpy(states.data(), take((states.size() + 3) / 4), states.size());
+        tlb.InvalidateAll(pt_base);
+    }
+    uint32_t frame_count = *take(1);
+    if (frame_count != frame_refs.size()) {
+        throw std::runtime_error("checkpoint is for a different memory size");
+    }
+    const uint32_t *refs = take(frame_count);
+    frame_refs.assign(refs, refs + frame_count);
+    
+    allocator.Reload();
+}
+
+ManagePageTable::ProcessPages &ManagePageTable::Pages(mem::Addr pt_base){
+    ProcessPages &pages = process_pages[pt_base];
+    if (pages.states.empty()) {
+        size_t count = mem::kPageTableSizeBytes / sizeof(mem::PageTableEntry);
+        pages.states.resize(count, kPageNormal);
+        pages.referenced.resize(count, 0);
+        pages.swap_slots.resize(count, SwapSpace::kNoSlot);
+    }
+    return pages;
+}
+
+bool ManagePageTable::AllocateFrames(uint32_t count, std::vector<mem::Addr> &page_frames){
+    while (!allocator.GetFrames(count, page_frames)) {
+        if (swap == nullptr || !EvictPage()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ManagePageTable::AddResident(mem::Addr pt_base, mem::Addr vaddr){
+    if (swap == nullptr) {
+        return;
+    }
+    ResidentPage page = { pt_base, vaddr };
+    resident_pages.push_back(page);
+    Pages(pt_base).referenced.at(vaddr >> mem::kPageSizeBits) = 1;
+}
+
+bool ManagePageTable::EvictPage(void){
+    // Two full turns visit every page once with its referenced bit clear
+    for (size_t steps = 2 * resident_pages.size(); steps > 0 && !resident_pages.empty(); --steps) {
+        if (clock_hand >= resident_pages.size()) {
+            clock_hand = 0;
+        }
+        ResidentPage page = resident_pages[clock_hand];
+        mem::Addr pt_index = page.vaddr >> mem::kPageSizeBits;
+        ProcessPages &pages = Pages(page.pt_base);
+        
+        mem::PageTableEntry pt_entry;
+        mem::Addr pte_addr = page.pt_base + (pt_index * sizeof(pt_entry));
+        memory.movb(&pt_entry, pte_addr, sizeof(pt_entry));
+        
+        //drop pages no longer mapped
+        if ((pt_entry & mem::kPTE_PresentMask) == 0) {
+            resident_pages[clock_hand] = resident_pages.back();
+            resident_pages.pop_back();
+            continue;
+        }
+        
+        //give referenced pages a second chance
+        mem::Addr frame_addr = (pt_entry >> mem::kPageSizeBits) << mem::kPageSizeBits;
+        if (pages.referenced[pt_index] != 0) {
+            pages.referenced[pt_index] = 0;
+            tlb.Invalidate(page.pt_base, page.vaddr);  // next lookup sets it
+            ++clock_hand;
+            continue;
+        }
+        
+        //write the page unless its slot is still a clean copy
+        if (pages.swap_slots[pt_index] == SwapSpace::kNoSlot) {
+            uint8_t bytes[mem::kPageSize];
+            memory.movb(bytes, frame_addr, mem::kPageSize);
+            pages.swap_slots[pt_index] = swap->Allocate();
+            swap->Write(pages.swap_slots[pt_index], bytes);
+            ++swap_stats.dirty_writebacks;
+        }
+        bool writable = (pt_entry & mem::kPTE_WritableMask) != 0
+                || pages.states[pt_index] == kSwapClean
+                || pages.states[pt_index] == kCopyOnWrite;
+        pages.states[pt_index] = writable ? kSwappedWritable : kSwappedReadOnly;
+        
+        pt_entry = 0;
+        memory.movb(pte_addr, &pt_entry, sizeof(pt_entry));
+        tlb.Invalidate(page.pt_base, page.vaddr);
+        ++swap_stats.evictions;
+        resident_pages[clock_hand] = resident_pages.back();
+        resident_pages.pop_back();
+        
+        //a shared frame is freed when its last mapping is evicted
+        if (--frame_refs.at(frame_addr >> mem::kPageSizeBits) == 0) {
+            std::vector<mem::Addr> page_frames(1, frame_addr);
+            allocator.FreeFrames(1, page_frames);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ManagePageTable::ReleaseSwapSlot(ProcessPages &pages, size_t pt_index){
+    if (pages.swap_slots[pt_index] != SwapSpace::kNoSlot) {
+        swap->Release(pages.swap_slots[pt_index]);
+        pages.swap_slots[pt_index] = SwapSpace::kNoSlot;
+    }
+}
+
+bool ManagePageTable::LookupPage(mem::PSW psw0, mem::Addr vaddr, mem::PageTableEntry &pt_entry){
+    mem::Addr pt_base = ((psw0 >> mem::kPSW0_PageTableShift) & mem::kPSW0_PageTableMask) << mem::kPageSizeBits;
+    
+    if(tlb.Lookup(pt_base, vaddr, pt_entry)){
+        return true;
+    }
+    
+    //miss: read the entry from the page table
+    mem::Addr pt_index = vaddr >> mem::kPageSizeBits;
+    if(pt_index >= mem::kPageTableSizeBytes / sizeof(pt_entry)){
+        return false;
+    }
+    mem::Addr pte_addr = pt_base + (pt_index * sizeof(pt_entry));
+    memory.movb(&pt_entry, pte_addr, sizeof(pt_entry));
+    
+    if((pt_entry & mem::kPTE_PresentMask) == 0){
+        return false;
+    }
+    if(swap != nullptr){
+        Pages(pt_base).referenced[pt_index] = 1;
+    }
+    tlb.Insert(pt_base, vaddr, pt_entry);
+    return true;
+}
@@ -4,17 +4,26 @@
  * Created on August 10, 2019, 9:01 PM
  */
 
+#ifndef MANAGEPAGETABLE_H
+#define MANAGEPAGETABLE_H
+
 #include "BitMapAllocator.h"
+#include "SwapSpace.h"
+#include "TranslationCache.h"
 
 #include <MMU.h>
 
+#include <map>
+#include <vector>
+
 class ManagePageTable {
 public:
 /**
 * Constructor - build kernel page table and enter virtual mode
 * 
 * Must be in physical memory mode on entry. Creates kernel page table in MMU, 
-* enters virtual mode.
+* enters virtual mode. If memory has more frames than one page table can
+* map, the kernel stays in physical mode instead.
 * 
 * @param memory_ MMU class object to use for memory
 * @param allocator_ page frame allocator object
@@ -47,18 +56,188 @@ mem::Addr CreateProcessPageTable(void);
 * 
 * The requested pages are allocated and mapped into the page table of
 * the process whose PMCB is specified. Any pages
-* already mapped are ignored. Must be called in kernel mode.
+* already mapped are ignored. Pages are backed by frames in the order
+* allocated, and the page table span is updated with one read and one
+* write. Must be called in kernel mode.
 * 
 * @param psw0 PSW0 of process to modify
 * @param vaddr starting virtual address
 * @param count number of pages to map
+* @param contiguous if true, back the pages with physically contiguous
+*   frames when such a run is free
 * @throws std::runtime_error if unable to allocate memory for pages
 */
-void MapProcessPages(mem::PSW psw0, mem::Addr vaddr, size_t count);
+void MapProcessPages(mem::PSW psw0, mem::Addr vaddr, size_t count,
+        bool contiguous = false);
+
+/**
+* UnmapProcessPages - unmap pages from the memory of specified process
+* 
+* The page table entries of the range are cleared in one write. Frames no
+* longer mapped by any process are returned to the allocator in a single
+* FreeFrames call, and reserved or swapped out pages in the range are
+* dropped. Pages not mapped are ignored. Must be called in kernel mode.
+* 
+* @param psw0 PSW0 of process to modify
+* @param vaddr starting virtual address
+* @param count number of pages to unmap
+*/
+void UnmapProcessPages(mem::PSW psw0, mem::Addr vaddr, size_t count);
+
+/**
+* DestroyProcessPageTable - unmap all pages of a process and free its page
+*   table
+* 
+* The frames of the pages and the page table frame are returned in a
+* single FreeFrames call. The PSW0 must not be used afterwards. Must be
+* called in kernel mode.
+* 
+* @param psw0 PSW0 of process to destroy
+*/
+void DestroyProcessPageTable(mem::PSW psw0);
+
+/**
+* ReserveProcessPages - reserve pages for demand paging
+* 
+* The requested pages not already mapped are recorded as reserved, but no
+* frames are allocated; MapReservedPage maps each one on first access.
+* Must be called in kernel mode.
+* 
+* @param psw0 PSW0 of process to modify
+* @param vaddr starting virtual address
+* @param count number of pages to reserve
+*/
+void ReserveProcessPages(mem::PSW psw0, mem::Addr vaddr, size_t count);
+
+/**
+* MapReservedPage - allocate and map a reserved page
+* 
+* Called on a page fault. The new page is zeroed, and writable unless
+* SetPageWritePermission cleared that while it was reserved. Must be called
+* in kernel mode.
+* 
+* @param psw0 PSW0 of process
+* @param vaddr faulting virtual address
+* @return true if the page was reserved and is now mapped, false if it was
+*   not reserved
+* @throws std::runtime_error if unable to allocate memory for the page
+*/
+bool MapReservedPage(mem::PSW psw0, mem::Addr vaddr);
+
+/**
+* ForkProcessPageTable - create a copy-on-write copy of a process's pages
+* 
+* The new page table maps the same frames as the parent. Pages writable in
+* the parent become read-only copy-on-write pages in both, and the first
+* write to one from either process copies it (see CopyOnWrite). Reserved
+* pages are reserved in the child too. Must be called in kernel mode.
+* 
+* @param parent_psw0 PSW0 of process to copy
+* @return kernel address of new page table
+* @throws std::runtime_error if unable to allocate memory for page table
+*/
+mem::Addr ForkProcessPageTable(mem::PSW parent_psw0);
+
+/**
+* CopyOnWrite - give a process its own writable copy of a shared page
+* 
+* Called on a write permission fault. If other page tables still map the
+* frame, the page is copied into a new frame; otherwise the page is just
+* made writable. Must be called in kernel mode.
+* 
+* @param psw0 PSW0 of process
+* @param vaddr faulting virtual address
+* @return true if the page was copy-on-write and is now writable, false if
+*   it is read-only
+* @throws std::runtime_error if unable to allocate memory for the copy
+*/
+bool CopyOnWrite(mem::PSW psw0, mem::Addr vaddr);
+
+// Number of page tables mapping a frame
+uint32_t get_frame_refs(mem::Addr frame_addr) const {
+    return frame_refs.at(frame_addr >> mem::kPageSizeBits);
+}
+
+/**
+* EnableSwap - evict pages to swap when page frames run out
+* 
+* Victims are chosen by the clock (second chance) policy. A page counts as
+* referenced if it was looked up by LookupPage since the clock last passed
+* it. A frame shared after a fork is freed once every mapping of it has
+* been evicted. An evicted page is written
+* to swap unless the swap slot it was read from is still an exact copy,
+* and its PTE is marked not present; SwapIn brings it back on a page
+* fault.
+* 
+* @param swap_ backing store for evicted pages
+*/
+void EnableSwap(SwapSpace &swap_);
+
+/**
+* SwapIn - read a swapped-out page back into a new frame
+* 
+* Called on a page fault. The page is mapped read-only until the first
+* write (see MarkDirty), so that it can be evicted again without a write
+* while it is clean. Must be called in kernel mode.
+* 
+* @param psw0 PSW0 of process
+* @param vaddr faulting virtual address
+* @return true if the page was swapped out and is now mapped, false if not
+* @throws std::runtime_error if unable to allocate memory for the page
+*/
+bool SwapIn(mem::PSW psw0, mem::Addr vaddr);
+
+/**
+* MarkDirty - make a clean swapped-in page writable on its first write
+* 
+* Called on a write permission fault; the page's swap slot is released.
+* Must be called in kernel mode.
+* 
+* @param psw0 PSW0 of process
+* @param vaddr faulting virtual address
+* @return true if the page was clean and writable, false if it is read-only
+*/
+bool MarkDirty(mem::PSW psw0, mem::Addr vaddr);
+
+/**
+* SaveState - append the host information on pages (page states and frame
+*   references) to a checkpoint. The page tables themselves are in memory.
+* 
+* @param words checkpoint state; words are pushed on back
+* @throws std::runtime_error if swap is enabled (swapped pages are not
+*   checkpointed)
+*/
+void SaveState(std::vector<uint32_t> &words) const;
+
+/**
+* RestoreState - replace the host information on pages with that saved by
+*   SaveState, after memory was restored from the same checkpoint, and have
+*   the allocator reload its bit map. Cached translations are dropped. Must
+*   be called in kernel mode.
+* 
+* @param next first word of the saved state; returns the word after it
+* @param end end of the checkpoint state
+* @throws std::runtime_error if the state is truncated or is for a
+*   different memory size
+*/
+void RestoreState(const uint32_t *&next, const uint32_t *end);
+
+// Allocator, for its statistics
+const BitMapAllocator &get_allocator(void) const { return allocator; }
+
+// Swap statistics
+struct SwapStats {
+    uint64_t evictions = 0;          // pages evicted
+    uint64_t swap_ins = 0;           // pages read back
+    uint64_t dirty_writebacks = 0;   // evictions that wrote the page
+};
+const SwapStats &get_swap_stats(void) const { return swap_stats; }
 
 /**
 * SetPageWritePermission - change writable bit for page(s)
 * 
+* A shared page made writable becomes copy-on-write. No frames are
+* allocated; the page table span is updated with one read and one write.
 * Must be called in kernel mode.
 * 
 * @param psw0 PSW0 of process to modify
@@ -69,9 +248,119 @@ void MapProcessPages(mem::PSW psw0, mem::Addr vaddr, size_t count);
 void SetPageWritePermission(
 mem::PSW psw0, mem::Addr vaddr, size_t count, uint32_t writable);
 
+/**
+* LookupPage - get page table entry for a virtual address
+* 
+* Consults the translation cache first and reads the page table only on a
+* miss. Present entries read from the page table are cached. Must be
+* called in kernel mode.
+* 
+* @param psw0 PSW0 of process
+* @param vaddr virtual address
+* @param pt_entry returns the page table entry
+* @return true if the page is present, false if not
+*/
+bool LookupPage(mem::PSW psw0, mem::Addr vaddr, mem::PageTableEntry &pt_entry);
+
+// Translation cache, for hit/miss counters
+const TranslationCache &get_translation_cache(void) const { return tlb; }
+
 private:
 // Save references to memory and allocator
 mem::MMU &memory;
 BitMapAllocator &allocator;
+
+// Cache of present page table entries, kept coherent with every PTE update
+TranslationCache tlb;
+
+// State of each page of a process
+static const uint8_t kPageNormal = 0;
+static const uint8_t kReservedWritable = 1;
+static const uint8_t kReservedReadOnly = 2;
+static const uint8_t kCopyOnWrite = 3;   // present, shared, write copies
+static const uint8_t kSwapClean = 4;     // present, writable, write marks dirty
+static const uint8_t kSwappedWritable = 5;
+static const uint8_t kSwappedReadOnly = 6;
+
+// Host information on the pages of a process
+struct ProcessPages {
+    std::vector<uint8_t> states;
+    std::vector<uint8_t> referenced;    // looked up since clock passed
+    std::vector<uint32_t> swap_slots;   // slot holding a copy, or kNoSlot
+};
+
+// Pages of each process, by page table address
+std::map<mem::Addr, ProcessPages> process_pages;
+
+// Number of page table entries mapping each frame
+std::vector<uint32_t> frame_refs;
+
+// Swap, or nullptr if not enabled
+SwapSpace *swap;
+SwapStats swap_stats;
+
+// Mapped pages in clock order, and the clock hand
+struct ResidentPage {
+    mem::Addr pt_base;
+    mem::Addr vaddr;
+};
+std::vector<ResidentPage> resident_pages;
+size_t clock_hand;
+
+/**
+* ReadEntries/WriteEntries - copy a span of page table entries from or to
+*   a process page table with one movb
+* @param pt_base kernel address of the page table
+* @param first_index index of first entry in the span
+* @param entries host copy; its size is the number of entries
+*/
+void ReadEntries(mem::Addr pt_base, mem::Addr first_index,
+        std::vector<mem::PageTableEntry> &entries);
+void WriteEntries(mem::Addr pt_base, mem::Addr first_index,
+        const std::vector<mem::PageTableEntry> &entries);
+
+/**
+* ClearEntries - clear a span of page table entries and the host
+*   information on its pages
+* @param pt_base kernel address of the page table
+* @param first_index index of first entry in the span
+* @param count number of entries
+* @param free_frames frames no longer mapped are pushed on back
+*/
+void ClearEntries(mem::Addr pt_base, mem::Addr first_index, size_t count,
+        std::vector<mem::Addr> &free_frames);
+
+/**
+* Pages - get host information on a process's pages, creating it if needed
+* @param pt_base kernel address of the process page table
+* @return page information
+*/
+ProcessPages &Pages(mem::Addr pt_base);
+
+/**
+* AllocateFrames - get page frames, evicting pages if swap is enabled
+* @param count number of page frames
+* @param page_frames page frame addresses allocated are pushed on back
+* @return true if success, false if not enough frames could be freed
+*/
+bool AllocateFrames(uint32_t count, std::vector<mem::Addr> &page_frames);
+
+/**
+* AddResident - record a newly mapped page for the clock
+*/
+void AddResident(mem::Addr pt_base, mem::Addr vaddr);
+
+/**
+* EvictPage - evict victims chosen by the clock until a frame is freed
+* @return true if a frame was freed, false if none can be
+*/
+bool EvictPage(void);
+
+/**
+* ReleaseSwapSlot - drop a page's swap slot, if it has one
+*/
+void ReleaseSwapSlot(ProcessPages &pages, size_t pt_index);
 };
 
+#endif /* MANAGEPAGETABLE_H */
+
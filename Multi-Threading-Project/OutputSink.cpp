@@ -0,0 +1,125 @@
+/*
+ * File:   OutputSink.cpp
+ *
+ * Created on October 17, 2026
+ */
+
+#include "OutputSink.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace {
+  const char kHexDigits[] = "0123456789abcdef";
+
+  // Two hex digits for each byte value
+  struct HexPairTable {
+    char pairs[256][2];
+
+    HexPairTable() {
+      for (int i = 0; i < 256; ++i) {
+        pairs[i][0] = kHexDigits[i >> 4];
+        pairs[i][1] = kHexDigits[i & 0xF];
+      }
+    }
+  };
+
+  const HexPairTable kHexPairs;
+}
+
+const int OutputSink::kNoFd;
+const size_t OutputSink::kDefaultCapacity;
+const size_t OutputSink::kMinCapacity;
+
+OutputSink::OutputSink(int fd_, size_t capacity)
+: fd(fd_), buffer(capacity < kMinCapacity ? kMinCapacity : capacity), used(0)
+{
+}
+
+OutputSink::~OutputSink(void) {
+  Flush();
+}
+
+void OutputSink::Write(const char *text, size_t length) {
+  if (length > buffer.size() - used && fd == kNoFd) {
+    MakeRoom(length);
+  } else if (length > buffer.size() - used) {
+    Flush();
+    // Write large blocks straight through
+    if (length >= buffer.size()) {
+      while (length > 0) {
+        ssize_t written = ::write(fd, text, length);
+        if (written < 0) {
+          if (errno == EINTR) continue;
+          return;
+        }
+        text += written;
+        length -= written;
+      }
+      return;
+    }
+  }
+  memcpy(buffer.data() + used, text, length);
+  used += length;
+}
+
+void OutputSink::Hex(uint32_t value, int width) {
+  // Format right to left into a scratch field
+  char digits[8];
+  int count = 0;
+  do {
+    digits[7 - count++] = kHexDigits[value & 0xF];
+    value >>= 4;
+  } while (value != 0);
+
+  Reserve(width + count);
+  for (int pad = width - count; pad > 0; --pad) {
+    buffer[used++] = '0';
+  }
+  memcpy(buffer.data() + used, digits + 8 - count, count);
+  used += count;
+}
+
+void OutputSink::HexByte(uint8_t value) {
+  Reserve(2);
+  buffer[used++] = kHexPairs.pairs[value][0];
+  buffer[used++] = kHexPairs.pairs[value][1];
+}
+
+void OutputSink::Dec(long value) {
+  char digits[24];
+  int count = 0;
+  unsigned long magnitude = (value < 0) ? 0 - static_cast<unsigned long>(value) : value;
+  do {
+    digits[sizeof(digits) - 1 - count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (value < 0) digits[sizeof(digits) - 1 - count++] = '-';
+  Write(digits + sizeof(digits) - count, count);
+}
+
+void OutputSink::MakeRoom(size_t length) {
+  if (fd == kNoFd) {
+    buffer.resize(std::max(2 * buffer.size(), used + length));
+  } else {
+    Flush();
+  }
+}
+
+void OutputSink::Flush(void) {
+  if (fd == kNoFd) return;
+  const char *next = buffer.data();
+  while (used > 0) {
+    ssize_t written = ::write(fd, next, used);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      break;  // output lost, as with a failed stream
+    }
+    next += written;
+    used -= written;
+  }
+  used = 0;
+}
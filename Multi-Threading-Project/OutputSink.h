@@ -0,0 +1,107 @@
+/*
+ * File:   OutputSink.h
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef OUTPUTSINK_H
+#define OUTPUTSINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class OutputSink {
+public:
+  // File descriptor of a sink that only buffers: the buffer grows instead
+  // of being flushed, and its contents are passed on with MoveTo
+  static const int kNoFd = -1;
+
+  /**
+   * Constructor
+   *
+   * @param fd_ file descriptor written on flush, or kNoFd
+   * @param capacity bytes buffered before a flush
+   */
+  OutputSink(int fd_ = 1, size_t capacity = kDefaultCapacity);
+
+  /**
+   * Destructor - flush buffered output
+   */
+  virtual ~OutputSink(void);
+
+  // Disallow copy/move
+  OutputSink(const OutputSink &other) = delete;
+  OutputSink(OutputSink &&other) = delete;
+  OutputSink &operator=(const OutputSink &other) = delete;
+  OutputSink &operator=(OutputSink &&other) = delete;
+
+  // Append text
+  void Write(const char *text, size_t length);
+  void Write(const std::string &text) { Write(text.data(), text.size()); }
+  void Put(char c) {
+    if (used == buffer.size()) MakeRoom(1);
+    buffer[used++] = c;
+  }
+
+  /**
+   * Hex - append value in lower case hex, zero filled to width digits
+   *   (same as std::hex with setw(width) and setfill('0'))
+   *
+   * @param value value to format
+   * @param width minimum number of digits
+   */
+  void Hex(uint32_t value, int width);
+
+  /**
+   * HexByte - append exactly two hex digits
+   *
+   * @param value byte to format
+   */
+  void HexByte(uint8_t value);
+
+  /**
+   * Dec - append value in decimal
+   *
+   * @param value value to format
+   */
+  void Dec(long value);
+
+  /**
+   * Flush - write buffered output to the file descriptor; no effect with
+   *   kNoFd
+   */
+  void Flush(void);
+
+  /**
+   * MoveTo - append the buffered output to another sink and empty this one
+   *
+   * @param other sink receiving the output
+   */
+  void MoveTo(OutputSink &other) {
+    other.Write(buffer.data(), used);
+    used = 0;
+  }
+
+private:
+  static const size_t kDefaultCapacity = 0x10000;
+
+  // Smallest buffer; holds any single formatted number
+  static const size_t kMinCapacity = 64;
+
+  int fd;
+  std::vector<char> buffer;
+  size_t used;
+
+  // Make room for length bytes, flushing if needed
+  void Reserve(size_t length) {
+    if (buffer.size() - used < length) MakeRoom(length);
+  }
+
+  // Flush, or grow the buffer of a kNoFd sink to fit length more bytes
+  void MakeRoom(size_t length);
+};
+
+#endif /* OUTPUTSINK_H */
+
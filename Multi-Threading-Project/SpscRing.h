@@ -0,0 +1,157 @@
+/*
+ * File:   SpscRing.h
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/*
+ * SpscRing - bounded ring of reusable slots passed from one producer thread
+ * to one consumer thread, in order.
+ *
+ * Slots are filled in place (BeginPush/EndPush) and drained in place
+ * (BeginPop/EndPop), so objects holding buffers keep their capacity between
+ * uses. A full ring blocks the producer (back-pressure) and an empty ring
+ * blocks the consumer; each side spins briefly before sleeping. A consumer
+ * that stops early cancels the ring, so the producer can be joined.
+ */
+template <typename T>
+class SpscRing {
+public:
+  /**
+   * Constructor
+   *
+   * @param capacity number of slots; the producer can run at most this many
+   *   items ahead of the consumer
+   * @throws std::invalid_argument if capacity is 0
+   */
+  explicit SpscRing(size_t capacity)
+  : slots(capacity), head(0), tail(0), closed(false), cancelled(false),
+    waiters(0) {
+    if (capacity == 0) {
+      throw std::invalid_argument("ring capacity must be non-zero");
+    }
+  }
+
+  virtual ~SpscRing() {}  // empty destructor
+
+  // Disallow copy/move
+  SpscRing(const SpscRing &other) = delete;
+  SpscRing(SpscRing &&other) = delete;
+  SpscRing &operator=(const SpscRing &other) = delete;
+  SpscRing &operator=(SpscRing &&other) = delete;
+
+  /**
+   * BeginPush - wait for a free slot (producer only)
+   *
+   * @return slot to fill, published by EndPush; or nullptr if the ring was
+   *   cancelled, in which case the producer must stop
+   */
+  T *BeginPush() {
+    size_t t = tail.load(std::memory_order_relaxed);
+    Wait([&] {
+      return t - head.load(std::memory_order_acquire) < slots.size()
+              || cancelled.load(std::memory_order_acquire);
+    });
+    if (cancelled.load(std::memory_order_acquire)) return nullptr;
+    return &slots[t % slots.size()];
+  }
+
+  /**
+   * EndPush - publish the slot returned by BeginPush (producer only)
+   */
+  void EndPush() {
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+    Wake();
+  }
+
+  /**
+   * Close - mark that no more items will be pushed (producer only)
+   */
+  void Close() {
+    closed.store(true, std::memory_order_seq_cst);
+    Wake();
+  }
+
+  /**
+   * Cancel - stop the producer: a waiting or later BeginPush returns
+   *   nullptr (consumer only). Items not yet popped are abandoned.
+   */
+  void Cancel() {
+    cancelled.store(true, std::memory_order_seq_cst);
+    Wake();
+  }
+
+  /**
+   * BeginPop - wait for the next item (consumer only)
+   *
+   * @return next item, or nullptr if the ring is closed and empty; the slot
+   *   is returned to the producer by EndPop
+   */
+  T *BeginPop() {
+    size_t h = head.load(std::memory_order_relaxed);
+    Wait([&] {
+      return tail.load(std::memory_order_acquire) != h
+              || closed.load(std::memory_order_acquire);
+    });
+    if (tail.load(std::memory_order_acquire) == h) return nullptr;
+    return &slots[h % slots.size()];
+  }
+
+  /**
+   * EndPop - release the slot returned by BeginPop (consumer only)
+   */
+  void EndPop() {
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+    Wake();
+  }
+
+private:
+  // Number of polls before a waiting side sleeps
+  static const int kSpinCount = 256;
+
+  std::vector<T> slots;
+
+  // Count of items popped and pushed; slot index is count modulo capacity
+  std::atomic<size_t> head;
+  std::atomic<size_t> tail;
+  std::atomic<bool> closed;
+  std::atomic<bool> cancelled;
+
+  // Number of threads sleeping on wake_up
+  std::atomic<int> waiters;
+  std::mutex wake_mutex;
+  std::condition_variable wake_up;
+
+  template <typename Ready>
+  void Wait(Ready ready) {
+    for (int i = 0; i < kSpinCount; ++i) {
+      if (ready()) return;
+      std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    wake_up.wait(lock, ready);
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void Wake() {
+    if (waiters.load(std::memory_order_seq_cst) > 0) {
+      std::lock_guard<std::mutex> lock(wake_mutex);
+      wake_up.notify_all();
+    }
+  }
+};
+
+#endif /* SPSCRING_H */
+
@@ -0,0 +1,87 @@
+/*
+ * File:   SwapSpace.cpp
+ *
+ * Created on October 17, 2026
+ */
+
+#include "SwapSpace.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+const uint32_t SwapSpace::kNoSlot;
+
+SwapSpace::SwapSpace(const std::string &file_name)
+: fd(-1), used_count(0)
+{
+  if (file_name.empty()) {
+    char temp_name[] = "/tmp/swapXXXXXX";
+    fd = mkstemp(temp_name);
+    if (fd >= 0) unlink(temp_name);  // removed when closed
+  } else {
+    fd = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  }
+  if (fd < 0) {
+    throw std::runtime_error("failed to create swap file: "
+            + (file_name.empty() ? std::string("(temporary)") : file_name));
+  }
+}
+
+SwapSpace::~SwapSpace(void) {
+  close(fd);
+}
+
+uint32_t SwapSpace::Allocate(void) {
+  uint32_t slot;
+  if (!free_slots.empty()) {
+    slot = free_slots.back();
+    free_slots.pop_back();
+  } else {
+    slot = slot_refs.size();
+    slot_refs.push_back(0);
+  }
+  slot_refs[slot] = 1;
+  ++used_count;
+  return slot;
+}
+
+void SwapSpace::Release(uint32_t slot) {
+  if (--slot_refs.at(slot) == 0) {
+    free_slots.push_back(slot);
+    --used_count;
+  }
+}
+
+void SwapSpace::Write(uint32_t slot, const void *page) {
+  const char *data = static_cast<const char *>(page);
+  off_t offset = static_cast<off_t>(slot) * mem::kPageSize;
+  size_t done = 0;
+  while (done < mem::kPageSize) {
+    ssize_t written = pwrite(fd, data + done, mem::kPageSize - done, offset + done);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      throw std::runtime_error("failed to write swap file");
+    }
+    done += written;
+  }
+}
+
+void SwapSpace::Read(uint32_t slot, void *page) {
+  char *data = static_cast<char *>(page);
+  off_t offset = static_cast<off_t>(slot) * mem::kPageSize;
+  size_t done = 0;
+  while (done < mem::kPageSize) {
+    ssize_t got = pread(fd, data + done, mem::kPageSize - done, offset + done);
+    if (got < 0) {
+      if (errno == EINTR) continue;
+      throw std::runtime_error("failed to read swap file");
+    }
+    if (got == 0) throw std::runtime_error("swap slot past end of file");
+    done += got;
+  }
+}
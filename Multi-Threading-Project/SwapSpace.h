@@ -0,0 +1,83 @@
+/*
+ * File:   SwapSpace.h
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef SWAPSPACE_H
+#define SWAPSPACE_H
+
+#include <MMU.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * SwapSpace - page-sized slots in a local backing file.
+ *
+ * Slots are reference counted so that processes sharing a page after a
+ * fork can share its swapped copy. The file grows as slots are first used
+ * and is removed when the SwapSpace is destroyed, unless it was named by
+ * the caller.
+ */
+class SwapSpace {
+public:
+  // Returned as the slot of a page that has none
+  static const uint32_t kNoSlot = 0xFFFFFFFF;
+
+  /**
+   * Constructor - create the backing file
+   *
+   * @param file_name path of backing file, truncated if it exists; if
+   *   empty, an unnamed temporary file is used
+   * @throws std::runtime_error if the file can not be created
+   */
+  explicit SwapSpace(const std::string &file_name = std::string());
+
+  /**
+   * Destructor - close the backing file
+   */
+  virtual ~SwapSpace(void);
+
+  // Disallow copy/move
+  SwapSpace(const SwapSpace &other) = delete;
+  SwapSpace(SwapSpace &&other) = delete;
+  SwapSpace &operator=(const SwapSpace &other) = delete;
+  SwapSpace &operator=(SwapSpace &&other) = delete;
+
+  /**
+   * Allocate - get an unused slot, with one reference
+   *
+   * @return slot number
+   */
+  uint32_t Allocate(void);
+
+  // Add or drop a reference to a slot; a slot with none is reused
+  void AddRef(uint32_t slot) { ++slot_refs.at(slot); }
+  void Release(uint32_t slot);
+
+  /**
+   * Write/Read - copy one page to or from a slot
+   *
+   * @param slot slot number
+   * @param page kPageSize bytes
+   * @throws std::runtime_error on an I/O error
+   */
+  void Write(uint32_t slot, const void *page);
+  void Read(uint32_t slot, void *page);
+
+  // Number of slots holding pages
+  uint32_t get_used_count(void) const { return used_count; }
+
+private:
+  int fd;
+
+  // References to each slot in the file, and slots with none
+  std::vector<uint32_t> slot_refs;
+  std::vector<uint32_t> free_slots;
+  uint32_t used_count;
+};
+
+#endif /* SWAPSPACE_H */
+
@@ -5,20 +5,31 @@
  */
 
 #include "Trace.h"
+#include "CompareKernels.h"
+#include "OutputSink.h"
+#include "SpscRing.h"
 
 #include <algorithm>
 #include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <iomanip>
 #include <ios>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 
 using std::cerr;
 using std::cin;
 using std::copy;
-using std::cout;
 using std::dec;
 using std::getline;
 using std::hex;
@@ -33,12 +44,151 @@ namespace {
   
   // Define memory block size
   const uint32_t kBlockSize = 0x400;
+  
+  // Initial size of text trace read buffer
+  const size_t kReadBufferSize = 0x100000;
+  
+  // User mode, virtual mode PSW0 for a process page table
+  mem::PSW UserPsw0(mem::Addr pt_base) {
+    return (static_cast<mem::PSW> (pt_base) << (mem::kPSW0_PageTableShift - mem::kPageSizeBits))
+            | (mem::kPSW0_UModeMask << mem::kPSW0_UModeShift)
+            | (mem::kPSW0_VModeMask << mem::kPSW0_VModeShift);
+  }
+  
+  // Check that count pages from vaddr are all within the one page table
+  // of a process
+  bool InPageTable(mem::Addr vaddr, uint32_t count) {
+    return (vaddr >> mem::kPageSizeBits) + uint64_t(count)
+            <= mem::kPageTableSizeBytes / sizeof(mem::PageTableEntry);
+  }
+  
+  // Value of hex digit, or -1 if not a hex digit
+  int HexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+  
+  // Commands read ahead by RunParallel, and the initial size of each one's
+  // output buffer
+  const size_t kParallelWindow = 64;
+  const size_t kSlotOutputCapacity = 256;
+  
+  // Output buffer of the command a RunParallel worker is running
+  thread_local OutputSink *command_output = nullptr;
+  
+  // Virtual address ranges [begin, end) a memory command reads and writes,
+  // as 64 bits so that ranges reaching past 4GB do not wrap
+  struct AddressRanges {
+    uint64_t read_begin, read_end;
+    uint64_t write_begin, write_end;
+  };
+  
+  // Fills in the ranges of a memory command with all its operands; returns
+  // false for any other command
+  bool MemoryRanges(const vector<uint32_t> &hexVals, AddressRanges &ranges) {
+    ranges = AddressRanges{ 0, 0, 0, 0 };
+    size_t size = hexVals.size();
+    switch (hexVals[0]) {
+      case 0x301:  // addr values...
+      case 0xCB1:
+        if (size < 2) return false;
+        if (hexVals[0] == 0x301) {
+          ranges.write_begin = hexVals[1];
+          ranges.write_end = ranges.write_begin + (size - 2);
+        } else {
+          ranges.read_begin = hexVals[1];
+          ranges.read_end = ranges.read_begin + (size - 2);
+        }
+        return true;
+      case 0x30A:  // count addr value
+        if (size < 4) return false;
+        ranges.write_begin = hexVals[2];
+        ranges.write_end = ranges.write_begin + hexVals[1];
+        return true;
+      case 0xCBA:  // count addr value
+      case 0x4F0:  // count addr
+        if (size < ((hexVals[0] == 0xCBA) ? 4u : 3u)) return false;
+        ranges.read_begin = hexVals[2];
+        ranges.read_end = ranges.read_begin + hexVals[1];
+        return true;
+      case 0x31D:  // count dest src
+        if (size < 4) return false;
+        ranges.write_begin = hexVals[2];
+        ranges.write_end = ranges.write_begin + hexVals[1];
+        ranges.read_begin = hexVals[3];
+        ranges.read_end = ranges.read_begin + hexVals[1];
+        return true;
+      default:
+        return false;
+    }
+  }
+  
+  bool Overlap(uint64_t begin1, uint64_t end1, uint64_t begin2, uint64_t end2) {
+    return begin1 < end2 && begin2 < end1;
+  }
+  
+  // True if the commands must run in trace order: one writes what the
+  // other reads or writes
+  bool Conflict(const AddressRanges &a, const AddressRanges &b) {
+    return Overlap(a.write_begin, a.write_end, b.write_begin, b.write_end)
+            || Overlap(a.write_begin, a.write_end, b.read_begin, b.read_end)
+            || Overlap(a.read_begin, a.read_end, b.write_begin, b.write_end);
+  }
+  
+  // Commands read ahead by RunPeephole
+  const size_t kPeepholeWindow = 16;
+  
+  // True if a CBA or CB1 command only reads bytes in [addr, end), all just
+  // written with a fill of value or with bytes (bytes[0] at addr), and
+  // expects exactly the bytes written, so it can not report a mismatch
+  bool MatchesWrite(const vector<uint32_t> &hexVals, mem::Addr addr, uint64_t end,
+                    bool fill, uint8_t value, const vector<uint8_t> &bytes) {
+    uint64_t begin;
+    uint64_t count;
+    if (hexVals[0] == 0xCBA && hexVals.size() >= 4) {
+      count = hexVals[1];
+      begin = hexVals[2];
+    } else if (hexVals[0] == 0xCB1 && hexVals.size() >= 2) {
+      count = hexVals.size() - 2;
+      begin = hexVals[1];
+    } else {
+      return false;
+    }
+    if (begin < addr || begin + count > end) return false;
+    
+    for (uint64_t i = 0; i < count; ++i) {
+      uint32_t expected = (hexVals[0] == 0xCBA) ? hexVals[3] : hexVals[i + 2];
+      uint8_t written = fill ? value : bytes[begin - addr + i];
+      if (expected != written) return false;
+    }
+    return true;
+  }
+  
+  // Text as a quoted JSON string
+  std::string JsonString(const std::string &text) {
+    std::ostringstream quoted;
+    quoted << '"';
+    for (unsigned char c : text) {
+      if (c == '"' || c == '\\') {
+        quoted << '\\' << c;
+      } else if (c < 0x20) {
+        quoted << "\\u" << hex << setw(4) << setfill('0') << int(c) << dec;
+      } else {
+        quoted << c;
+      }
+    }
+    quoted << '"';
+    return quoted.str();
+  }
 }
 
 class PageFaultHandler : public mem::MMU::FaultHandler{
 public:
 
-    PageFaultHandler() : fault_count(0) {
+    PageFaultHandler(OutputSink &output_, std::function<bool(mem::Addr)> map_on_demand_)
+    : fault_count(0), output(output_), map_on_demand(map_on_demand_) {
     }
     
     virtual bool Run(mem::PSW psw0) {
@@ -50,12 +200,21 @@ public:
         
               
         mem::Addr next_vaddr = (psw0 >> mem::kPSW0_NextAddrShift) & mem::kPSW0_NextAddrMask;
+        
+        //a reserved or swapped out page is mapped and the access retried
+        if(map_on_demand(next_vaddr)){
+            return true;
+        }
+        
+        OutputSink &out = (command_output != nullptr) ? *command_output : output;
         if(fault_type == mem::kPSW0_OpRead){
-            std::cout << "Read";
+            out.Write("Read", 4);
         }else {
-            std::cout << "Write";
+            out.Write("Write", 5);
         }
-        std::cout << "Page Fault at " << hex << setfill('0') << setw(8) << next_vaddr << "\n";
+        out.Write("Page Fault at ", 14);
+        out.Hex(next_vaddr, 8);
+        out.Put('\n');
         
         return false;
     }
@@ -77,12 +236,19 @@ private:
 
     // PSW0 and 1 from last fault handled
     mem::PSW last_psw0;
+    
+    // Trace output, unless the faulting command has its own
+    OutputSink &output;
+    
+    // Maps a reserved or swapped out page
+    std::function<bool(mem::Addr)> map_on_demand;
 };
 
 class WriteFaultHandler : public mem::MMU::FaultHandler {
 public:
 
-    WriteFaultHandler() : fault_count(0) {
+    WriteFaultHandler(OutputSink &output_, std::function<bool(mem::Addr)> copy_on_write_)
+    : fault_count(0), output(output_), copy_on_write(copy_on_write_) {
     }
     
     virtual bool Run(mem::PSW psw0) {
@@ -91,7 +257,15 @@ public:
         
         mem::Addr next_vaddr = (psw0 >> mem::kPSW0_NextAddrShift) & mem::kPSW0_NextAddrMask;
         
-        std::cout << "Write Permission Fault at " << hex << setfill('0') << setw(8) << next_vaddr << "\n";
+        //a copy-on-write page is copied and the access retried
+        if(copy_on_write(next_vaddr)){
+            return true;
+        }
+        
+        OutputSink &out = (command_output != nullptr) ? *command_output : output;
+        out.Write("Write Permission Fault at ", 26);
+        out.Hex(next_vaddr, 8);
+        out.Put('\n');
         
         return false;
     }
@@ -109,125 +283,694 @@ private:
 
     // PSW0 from last fault handled
     mem::PSW last_psw0;
+    
+    // Trace output, unless the faulting command has its own
+    OutputSink &output;
+    
+    // Copies a shared page
+    std::function<bool(mem::Addr)> copy_on_write;
 };
 
 
-Trace::Trace(std::string file_name_, mem::MMU &memory_, ManagePageTable &pt_manager_) 
-: file_name(file_name_), line_number(0), memory(memory_), pt_manager(pt_manager_) { 
+Trace::Trace(std::string file_name_, mem::MMU &memory_, ManagePageTable &pt_manager_,
+             KernelLock &kernel_lock_, const TraceOptions &options_) 
+: options(options_), file_name(file_name_), line_number(0), read_pos(0), read_end(0),
+  read_error(false), read_offset(0), output(options_.output_fd),
+  memory(memory_), pt_manager(pt_manager_), kernel_lock(kernel_lock_),
+  next_checkpoint_line(0) { 
   // Open the trace file.  Abort program if can't open.
-  trace.open(file_name, std::ios_base::in);
-  if (!trace.is_open()) {
-    cerr << "ERROR: failed to open trace file: " << file_name << "\n";
-    exit(2);
+  if (CompiledTrace::IsCompiled(file_name)) {
+    try {
+      compiled.reset(new CompiledTrace(file_name));
+    } catch (const std::runtime_error &e) {
+      cerr << "ERROR: " << e.what() << "\n";
+      exit(2);
+    }
+  } else {
+    trace.open(file_name, std::ios_base::in | std::ios_base::binary);
+    if (!trace.is_open()) {
+      cerr << "ERROR: failed to open trace file: " << file_name << "\n";
+      exit(2);
+    }
+    read_buffer.resize(kReadBufferSize);
   }
   
-  // Set up user page table
+  // Set up user page table, or restore all page tables and memory from a
+  // checkpoint (no process context is loaded afterwards)
+    bool switched;
+    std::unique_lock<std::recursive_mutex> lock = kernel_lock.Acquire(nullptr, switched);
     memory.set_kernel_mode();
-    mem::Addr pt_base = pt_manager.CreateProcessPageTable();
-    user_psw0 = (static_cast<mem::PSW> (pt_base) << (mem::kPSW0_PageTableShift - mem::kPageSizeBits))
-            | (mem::kPSW0_UModeMask << mem::kPSW0_UModeShift)
-            | (mem::kPSW0_VModeMask << mem::kPSW0_VModeShift);
+    if (options.resume_file.empty()) {
+      mem::Addr pt_base = pt_manager.CreateProcessPageTable();
+      user_psw0 = UserPsw0(pt_base);
+      process_psw0s.push_back(user_psw0);
+    } else {
+      Resume();
+    }
+    
+    // Open the checkpoint image; resuming from it compares with the memory
+    // just restored
+    if (!options.checkpoint_file.empty()) {
+      try {
+        checkpoint.reset(new Checkpoint(options.checkpoint_file, memory, pt_manager,
+                                        options.checkpoint_file == options.resume_file));
+      } catch (const std::runtime_error &e) {
+        cerr << "ERROR: " << e.what() << "\n";
+        exit(2);
+      }
+      next_checkpoint_line = line_number + options.checkpoint_every;
+    }
+    lock.unlock();
 
     // Create fault handlers
-    page_fault_handler = std::make_shared<PageFaultHandler>();
-    write_fault_handler = std::make_shared<WriteFaultHandler>();
+    page_fault_handler = std::make_shared<PageFaultHandler>(output,
+            [this](mem::Addr vaddr) { return MapOnDemand(vaddr); });
+    write_fault_handler = std::make_shared<WriteFaultHandler>(output,
+            [this](mem::Addr vaddr) { return CopyOnWrite(vaddr); });
 }
 
 Trace::~Trace() {
-  trace.close();
+  if (trace.is_open()) trace.close();
+  
+  // Return the memory of each address space; no process context is left
+  // loaded
+  bool switched;
+  std::unique_lock<std::recursive_mutex> lock = kernel_lock.Acquire(nullptr, switched);
+  memory.set_kernel_mode();
+  for (mem::PSW psw0 : process_psw0s) {
+    pt_manager.DestroyProcessPageTable(psw0);
+  }
 }
 
 void Trace::RunTrace(void) {
+  // User PSW0 and fault handlers are loaded by LockKernel
+  
+  // Read and process commands
+  try {
+    if (options.parallel_workers > 0) {
+      RunParallel();
+    } else if (options.pipeline_depth > 0) {
+      RunPipelined();
+    } else if (options.peephole) {
+      RunPeephole();
+    } else {
+      Command command;
+      while (ReadCommand(command)) {
+        ExecuteCommand(command);
+      }
+    }
+  } catch (...) {
+    output.Flush();  // keep output preceding an uncaught error
+    throw;
+  }
+  output.Flush();
+  if (options.stats) {
+    WriteStats();
+  } else if (options.peephole) {
+    std::ostringstream line;
+    line << "peephole " << file_name << ": ";
+    stats.WritePeepholeJson(line);
+    line << "\n";
+    OutputSink report(2);
+    report.Write(line.str());
+  }
+}
+
+void Trace::WriteStats(void) {
+  int page_faults = static_cast<PageFaultHandler *>(page_fault_handler.get())->get_fault_count();
+  int write_faults = static_cast<WriteFaultHandler *>(write_fault_handler.get())->get_fault_count();
+  
+  std::ostringstream json;
+  json << "{\n  \"trace\": " << JsonString(file_name) << ",\n"
+       << "  \"commands\": ";
+  stats.WriteCommandsJson(json, 4);
+  json << ",\n  \"movb_calls\": " << stats.get_movb_calls() << ",\n"
+       << "  \"faults\": {\"page\": " << page_faults
+       << ", \"write\": " << write_faults << "},\n";
+  if (options.peephole) {
+    json << "  \"peephole\": ";
+    stats.WritePeepholeJson(json);
+    json << ",\n";
+  }
+  if (checkpoint) {
+    json << "  \"checkpoints\": {\"records\": " << checkpoint->get_record_count()
+         << ", \"pages\": " << checkpoint->get_page_count() << "},\n";
+  }
+  
+  // Shared by all processes; read with the kernel lock held
+  {
+    std::unique_lock<std::recursive_mutex> lock = kernel_lock.Acquire();
+    const BitMapAllocator &allocator = pt_manager.get_allocator();
+    const TranslationCache &tlb = pt_manager.get_translation_cache();
+    ManagePageTable::SwapStats swap = pt_manager.get_swap_stats();
+    json << "  \"machine\": {\n"
+         << "    \"frames\": {\"total\": " << memory.get_frame_count()
+         << ", \"allocated\": " << allocator.get_frames_allocated()
+         << ", \"freed\": " << allocator.get_frames_freed()
+         << ", \"peak_in_use\": " << allocator.get_peak_in_use() << "},\n"
+         << "    \"zero_pool\": {\"hits\": " << allocator.get_zero_pool_hits()
+         << ", \"misses\": " << allocator.get_zero_pool_misses() << "},\n"
+         << "    \"tlb\": {\"hits\": " << tlb.get_hit_count()
+         << ", \"misses\": " << tlb.get_miss_count() << "},\n"
+         << "    \"swap\": {\"evictions\": " << swap.evictions
+         << ", \"swap_ins\": " << swap.swap_ins
+         << ", \"dirty_writebacks\": " << swap.dirty_writebacks << "}\n"
+         << "  }\n}\n";
+  }
+  
+  // One write, so reports of concurrent processes do not interleave
+  OutputSink report(2);
+  report.Write(json.str());
+}
+
+void Trace::RunPipelined(void) {
+  SpscRing<Command> ring(options.pipeline_depth);
+  
+  // Reader fills slots in order; echo and execution stay on this thread
+  std::thread reader([this, &ring] {
+    Command *command;
+    while ((command = ring.BeginPush()) != nullptr) {
+      if (!ReadCommand(*command)) break;
+      ring.EndPush();
+      if (!command->error.empty()) break;
+    }
+    ring.Close();
+  });
+  
+  Command *command;
+  try {
+    while ((command = ring.BeginPop()) != nullptr) {
+      if (!command->error.empty()) {
+        reader.join();  // reader stopped at the error; ExecuteCommand exits
+      }
+      ExecuteCommand(*command);
+      ring.EndPop();
+    }
+  } catch (...) {
+    // Reader may be blocked on a full ring; it uses the ring and this
+    // trace, so must stop before they are destroyed
+    ring.Cancel();
+    if (reader.joinable()) reader.join();
+    throw;
+  }
+  reader.join();
+}
+
+void Trace::RunParallel(void) {
+  // Command number n is held in slot n % kParallelWindow from when it is
+  // read until its output is committed
+  struct Slot {
+    Command command;
+    AddressRanges ranges;
+    OutputSink output{OutputSink::kNoFd, kSlotOutputCapacity};
+    bool done = false;                 // guarded by mutex
+    std::exception_ptr error;          // thrown by the command
+  };
+  std::vector<Slot> slots(kParallelWindow);
+  uint64_t next = 0;       // number of the next command to read
+  uint64_t committed = 0;  // number of the next command to commit
+  
+  std::mutex mutex;
+  std::condition_variable work_ready;
+  std::condition_variable work_done;
+  std::deque<Slot *> queue;
+  bool stopping = false;
+  
+  // Workers run queued memory commands into their slot buffers
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < options.parallel_workers; ++i) {
+    workers.emplace_back([&] {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (true) {
+        work_ready.wait(lock, [&] { return stopping || !queue.empty(); });
+        if (queue.empty()) return;
+        Slot *slot = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        command_output = &slot->output;
+        try {
+          ExecuteCommand(slot->command);
+        } catch (...) {
+          slot->error = std::current_exception();
+        }
+        command_output = nullptr;
+        lock.lock();
+        slot->done = true;
+        work_done.notify_all();
+      }
+    });
+  }
+  
+  // Workers stop when this returns or throws, dropping queued commands
+  struct WorkerJoin {
+    std::function<void()> join;
+    ~WorkerJoin() { join(); }
+  } worker_join{ [&] {
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      stopping = true;
+      queue.clear();
+    }
+    work_ready.notify_all();
+    for (std::thread &worker : workers) worker.join();
+  } };
+  
+  // Write the output of commands before number end in order, waiting for
+  // them to finish if wait is set; rethrow the first error
+  std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+  auto commit = [&](uint64_t end, bool wait) {
+    lock.lock();
+    while (committed < end) {
+      Slot &slot = slots[committed % kParallelWindow];
+      if (!slot.done) {
+        if (!wait) break;
+        work_done.wait(lock);
+        continue;
+      }
+      lock.unlock();
+      slot.output.MoveTo(output);
+      if (slot.error) std::rethrow_exception(slot.error);
+      ++committed;
+      lock.lock();
+    }
+    lock.unlock();
+  };
+  
+  while (true) {
+    if (next - committed == kParallelWindow) commit(committed + 1, true);
+    Slot &slot = slots[next % kParallelWindow];
+    if (!ReadCommand(slot.command)) break;
+    slot.done = false;
+    slot.error = nullptr;
     
-  //user psw0
-  memory.load_user_psw0(user_psw0);
+    const vector<uint32_t> &hexVals = slot.command.hexVals;
+    if (slot.command.error.empty() && hexVals[0] == kComment) {
+      // Only echoed
+      command_output = &slot.output;
+      ExecuteCommand(slot.command);
+      command_output = nullptr;
+      slot.done = true;
+    } else if (slot.command.error.empty() && MemoryRanges(hexVals, slot.ranges)) {
+      // Start once no unfinished earlier command conflicts
+      lock.lock();
+      for (uint64_t i = committed; i < next; ) {
+        const Slot &earlier = slots[i % kParallelWindow];
+        if (!earlier.done && Conflict(earlier.ranges, slot.ranges)) {
+          work_done.wait(lock);
+          i = committed;
+        } else {
+          ++i;
+        }
+      }
+      queue.push_back(&slot);
+      lock.unlock();
+      work_ready.notify_one();
+    } else {
+      // Kernel and process commands, errors: run alone, in order
+      commit(next, true);
+      ExecuteCommand(slot.command);
+      slot.done = true;
+    }
+    ++next;
+    commit(next, false);
+  }
+  commit(next, true);
+}
+
+void Trace::RunPeephole(void) {
+  // Window of commands read ahead: count of them from head, in a ring
+  vector<Command> window(kPeepholeWindow);
+  size_t head = 0;
+  size_t count = 0;
+  bool more = true;
+  vector<const Command *> pending;
   
-  //fault handlers
-  memory.SetPageFaultHandler(page_fault_handler);
-  memory.SetWritePermissionFaultHandler(write_fault_handler);
+  while (true) {
+    // Refill; nothing is read past a read error
+    while (more && count < kPeepholeWindow) {
+      Command &command = window[(head + count) % kPeepholeWindow];
+      more = ReadCommand(command);
+      if (more) {
+        ++count;
+        more = command.error.empty();
+      }
+    }
+    if (count == 0) break;
+    
+    pending.clear();
+    for (size_t i = 0; i < count; ++i) {
+      pending.push_back(&window[(head + i) % kPeepholeWindow]);
+    }
+    size_t done = ExecuteFused(pending);
+    if (done == 0) {
+      ExecuteCommand(*pending[0]);
+      done = 1;
+    }
+    head = (head + done) % kPeepholeWindow;
+    count -= done;
+  }
+}
+
+size_t Trace::ExecuteFused(const vector<const Command *> &pending) {
+  const vector<uint32_t> &first = pending[0]->hexVals;
+  if (!pending[0]->error.empty()) return 0;
   
-  // Read and process commands
-  std::string line; // text line read
-  std::string cmd; // command from line
-  vector<uint32_t> hexVals; // arguments from line
+  // The head of the window must write: a fill, or stores to consecutive
+  // addresses
+  mem::Addr addr;
+  uint64_t end;
+  bool fill = false;
+  uint8_t value = 0;
+  size_t writes = 1;
+  if (first[0] == 0x30A && first.size() >= 4) {
+    fill = true;
+    value = first[3];
+    addr = first[2];
+    end = uint64_t(addr) + first[1];
+    
+    // Skip a fill the next one overwrites
+    if (pending.size() > 1 && pending[1]->error.empty()) {
+      const vector<uint32_t> &next = pending[1]->hexVals;
+      if (next[0] == 0x30A && next.size() >= 4 && next[2] <= addr
+              && uint64_t(next[2]) + next[1] >= end && Writable(next[2], uint64_t(next[2]) + next[1])) {
+        EchoCommand(*pending[0]);
+        std::lock_guard<std::mutex> guard(stats_mutex);
+        stats.CountEliminated(TraceStats::kShadowedFills, 1);
+        if (options.stats) stats.RecordCommand(first, 0);
+        return 1;
+      }
+    }
+  } else if (first[0] == 0x301 && first.size() >= 2) {
+    addr = first[1];
+    fused_bytes.assign(first.begin() + 2, first.end());
+    end = uint64_t(addr) + fused_bytes.size();
+    for (; writes < pending.size(); ++writes) {
+      const vector<uint32_t> &next = pending[writes]->hexVals;
+      if (!pending[writes]->error.empty() || next[0] != 0x301 || next.size() < 2
+              || next[1] != end) {
+        break;
+      }
+      fused_bytes.insert(fused_bytes.end(), next.begin() + 2, next.end());
+      end += next.size() - 2;
+    }
+  } else {
+    return 0;
+  }
+  
+  // Compares that follow and can only match what was written
+  size_t compares = 0;
+  while (writes + compares < pending.size()
+          && pending[writes + compares]->error.empty()
+          && MatchesWrite(pending[writes + compares]->hexVals, addr, end,
+                          fill, value, fused_bytes)) {
+    ++compares;
+  }
+  if ((writes == 1 && compares == 0) || !Writable(addr, end)) return 0;
+  
+  // No fault can occur, so echoing all the stores first changes nothing
+  std::chrono::steady_clock::time_point start;
+  if (options.stats) start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < writes; ++i) EchoCommand(*pending[i]);
+  if (fill) {
+    FillBytes(addr, value, end - addr);
+  } else {
+    WriteBytes(addr, fused_bytes.data(), fused_bytes.size());
+  }
+  for (size_t i = 0; i < compares; ++i) EchoCommand(*pending[writes + i]);
+  
+  std::lock_guard<std::mutex> guard(stats_mutex);
+  stats.CountEliminated(TraceStats::kMergedStores, writes - 1);
+  stats.CountEliminated(TraceStats::kFoldedCompares, compares);
+  if (options.stats) {
+    // Time is shared evenly by the fused commands
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count() / (writes + compares);
+    for (size_t i = 0; i < writes + compares; ++i) {
+      stats.RecordCommand(pending[i]->hexVals, ns);
+    }
+  }
+  return writes + compares;
+}
+
+void Trace::EchoCommand(const Command &command) {
+  if (options.echo) {
+    OutputSink &out = CommandOutput();
+    out.Dec(command.line_number);
+    out.Put(':');
+    out.Write(command.text);
+    out.Put('\n');
+  }
+}
+
+void Trace::ExecuteCommand(const Command &command) {
+  if (!command.error.empty()) {
+    output.Flush();
+    cerr << "ERROR: " << command.error << "\n";
+    exit(2);
+  }
+  
+  EchoCommand(command);
   
   // Select the command to execute
-  while (InterpretCommand(hexVals)) {
-    switch (hexVals[0]) {
-      case 0xF01:
-        CodeF01(hexVals); // allocate virtual memory
-        break;
-      case 0xCB1:
-        CodeCB1(hexVals); // Compare to Specified Values
-        break;
-      case 0xCBA:
-        CodeCBA(hexVals); // Compare Single Value to Memory Range
-        break;
-      case 0x301:
-        Code301(hexVals); // Set Bytes
-        break;
-      case 0x30A:
-        Code30A(hexVals); // Set Multiple Bytes to Same Value
-        break;
-      case 0x31D:
-        Code31D(hexVals); // Replicate Range of Bytes From Source to Destination
-        break;
-      case 0x4F0:
-        Code4F0(hexVals); // Output Bytes
-        break;
-      case 0xFF1:
-        CodeFF1(hexVals);
-        break;
-      case 0xFF0:
-        CodeFF0(hexVals);
-        break;
-      case kComment:
-        break;
-      default:
-        cerr << "ERROR: invalid command\n";
-        exit(2);
+  const vector<uint32_t> &hexVals = command.hexVals;
+  std::chrono::steady_clock::time_point start;
+  if (options.stats) start = std::chrono::steady_clock::now();
+  switch (hexVals[0]) {
+    case 0xF01:
+      CodeF01(hexVals); // allocate virtual memory
+      break;
+    case 0xF00:
+      CodeF00(hexVals); // free virtual memory
+      break;
+    case 0xCB1:
+      CodeCB1(hexVals); // Compare to Specified Values
+      break;
+    case 0xCBA:
+      CodeCBA(hexVals); // Compare Single Value to Memory Range
+      break;
+    case 0x301:
+      Code301(hexVals); // Set Bytes
+      break;
+    case 0x30A:
+      Code30A(hexVals); // Set Multiple Bytes to Same Value
+      break;
+    case 0x31D:
+      Code31D(hexVals); // Replicate Range of Bytes From Source to Destination
+      break;
+    case 0x4F0:
+      Code4F0(hexVals); // Output Bytes
+      break;
+    case 0xFF1:
+      CodeFF1(hexVals);
+      break;
+    case 0xFF0:
+      CodeFF0(hexVals);
+      break;
+    case 0xF0F:
+      CodeF0F(hexVals); // Fork Process
+      break;
+    case 0xF05:
+      CodeF05(hexVals); // Switch to Process
+      break;
+    case 0xFC0:
+      if (checkpoint) WriteCheckpoint(command); // Checkpoint
+      break;
+    case kComment:
+      break;
+    default:
+      output.Flush();
+      cerr << "ERROR: invalid command\n";
+      exit(2);
+  }
+  if (options.stats && hexVals[0] != kComment) {
+    std::lock_guard<std::mutex> guard(stats_mutex);
+    stats.RecordCommand(hexVals, std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+  }
+  
+  // Periodic checkpoint, when due
+  if (options.checkpoint_every > 0 && command.line_number >= next_checkpoint_line) {
+    WriteCheckpoint(command);
+    next_checkpoint_line = command.line_number + options.checkpoint_every;
+  }
+}
+
+void Trace::Resume(void) {
+  try {
+    Checkpoint::TraceState state =
+            Checkpoint::Restore(options.resume_file, memory, pt_manager);
+    user_psw0 = state.user_psw0;
+    process_psw0s = state.process_psw0s;
+    line_number = state.line_number;
+    
+    // Continue reading after the checkpoint's line
+    if (compiled) {
+      compiled->Seek(state.offset, state.record);
+    } else {
+      trace.seekg(0, std::ios_base::end);
+      if (static_cast<uint64_t>(trace.tellg()) < state.offset) {
+        throw std::runtime_error("checkpoint position is past the end of " + file_name);
+      }
+      trace.seekg(state.offset);
+      read_offset = state.offset;
     }
+  } catch (const std::runtime_error &e) {
+    cerr << "ERROR: " << e.what() << "\n";
+    exit(2);
   }
 }
 
-bool Trace::InterpretCommand(vector<uint32_t> &hexVals) {
-  hexVals.clear();
-  std::string textLine;
+void Trace::WriteCheckpoint(const Command &command) {
+  // Output up to the checkpoint is complete if the run stops after it
+  output.Flush();
+  
+  Checkpoint::TraceState state;
+  state.line_number = command.line_number;
+  state.offset = command.next_offset;
+  state.record = command.next_record;
+  state.user_psw0 = user_psw0;
+  state.process_psw0s = process_psw0s;
+  
+  std::unique_lock<std::recursive_mutex> lock = LockKernel();
+  memory.set_kernel_mode();
+  try {
+    checkpoint->Write(state);
+  } catch (const std::runtime_error &e) {
+    cerr << "ERROR: " << e.what() << "\n";
+    exit(2);
+  }
+  memory.load_user_psw0(user_psw0);
+}
+
+bool Trace::ReadCommand(Command &command) {
+  command.error.clear();
   
-  // Read next textLine
-  if (getline(trace, textLine)) {
-    ++line_number;
-    cout << dec << line_number << ":" << textLine << "\n";
+  // Replay compiled trace: values were parsed when it was compiled
+  if (compiled) {
+    const char *text;
+    uint32_t text_length;
+    try {
+      if (!compiled->Next(line_number, text, text_length, command.hexVals)) {
+        return false;
+      }
+    } catch (const std::runtime_error &e) {
+      std::ostringstream message;
+      message << e.what() << ": " << file_name << " after line " << line_number;
+      command.error = message.str();
+      return true;
+    }
+    command.line_number = line_number;
+    command.text.assign(text, text_length);
+    command.next_offset = compiled->get_offset();
+    command.next_record = compiled->get_record();
+    return true;
+  }
+  
+  const char *text;
+  size_t text_length;
+  
+  // Read next line
+  if (!NextLine(text, text_length)) {
+    if (read_error) {
+      std::ostringstream message;
+      message << "read failed on trace file: " << file_name 
+              << " at line " << line_number;
+      command.error = message.str();
+      return true;
+    }
+    return false;
+  }
+  
+  ++line_number;
+  command.line_number = line_number;
+  command.text.assign(text, text_length);
+  command.next_offset = read_offset + read_pos;
+  command.next_record = 0;
+  ParseLine(text, text + text_length, command.hexVals);
+  return true;
+}
+
+bool Trace::NextLine(const char *&text, size_t &text_length) {
+  while (true) {
+    const char *begin = read_buffer.data() + read_pos;
+    const char *newline = static_cast<const char *>(
+            memchr(begin, '\n', read_end - read_pos));
+    if (newline != nullptr) {
+      text = begin;
+      text_length = newline - begin;
+      read_pos += text_length + 1;
+      return true;
+    }
     
-    // No further processing if comment
-    if (textLine.empty() || textLine[0] == '*') {
-      hexVals.push_back(kComment);
+    // At end of file, a final line may lack its newline
+    if (trace.eof()) {
+      if (read_pos == read_end) return false;
+      text = begin;
+      text_length = read_end - read_pos;
+      read_pos = read_end;
       return true;
     }
     
-    // Make a string stream from command line
-    istringstream lineStream(textLine);
+    // Move partial line to front of buffer (growing it only if one line
+    // fills the whole buffer) and refill
+    size_t partial = read_end - read_pos;
+    memmove(read_buffer.data(), begin, partial);
+    read_offset += read_pos;
+    if (partial == read_buffer.size()) read_buffer.resize(2 * partial);
+    read_pos = 0;
+    read_end = partial;
+    trace.read(read_buffer.data() + read_end, read_buffer.size() - read_end);
+    read_end += trace.gcount();
+    if (trace.bad()) {
+      read_error = true;
+      return false;
+    }
+  }
+}
+
+void Trace::ParseLine(const char *text, const char *text_end,
+                      vector<uint32_t> &hexVals) {
+  hexVals.clear();
+  
+  // No further processing if comment
+  if (text == text_end || *text == '*') {
+    hexVals.push_back(kComment);
+    return;
+  }
+  
+  // Read the hex values from the line
+  const char *next = text;
+  while (true) {
+    while (next != text_end && isspace(static_cast<unsigned char>(*next))) {
+      ++next;
+    }
     
-    // Read the hex values from the line
-    uint32_t hVal;
-    while (lineStream >> hex >> hVal) {
-      hexVals.push_back(hVal);
+    // Optional sign and 0x prefix, as accepted by stream extraction
+    bool negative = false;
+    if (next != text_end && (*next == '-' || *next == '+')) {
+      negative = (*next++ == '-');
+    }
+    if (text_end - next >= 2 && next[0] == '0' && (next[1] == 'x' || next[1] == 'X')) {
+      next += 2;
+      if (next == text_end || HexDigit(*next) < 0) break;  // prefix alone fails
     }
     
-    // If no values read, set as comment
-    if (hexVals.empty()) hexVals.push_back(kComment);
+    // Digits; stop on a missing or overflowing value
+    const char *digits = next;
+    uint64_t hVal = 0;
+    int digit;
+    while (next != text_end && (digit = HexDigit(*next)) >= 0) {
+      hVal = (hVal << 4) | digit;
+      if (hVal > UINT32_MAX) break;
+      ++next;
+    }
+    if (next == digits || hVal > UINT32_MAX) break;
     
-    return true;
+    hexVals.push_back(negative ? 0 - static_cast<uint32_t>(hVal) : hVal);
   }
   
-  // Check for eof or error
-  if (trace.eof()) {
-    return false;
-  } else {
-    cerr << "ERROR: getline failed on trace file: " << file_name 
-            << " at line " << line_number << "\n";
-    exit(2);
-  }
+  // If no values read, set as comment
+  if (hexVals.empty()) hexVals.push_back(kComment);
 }
 
 void Trace::CodeF01(const vector<uint32_t> &hexVals) {
@@ -237,14 +980,26 @@ void Trace::CodeF01(const vector<uint32_t> &hexVals) {
       
       //check to see if vaddr is a multiple of 0x400
       if(vaddr % 1024 == 0) {
+          if (!InPageTable(vaddr, count)) {
+              output.Flush();
+              cerr << "ERROR: page range is outside the page table\n";
+              exit(2);
+          }
+          std::unique_lock<std::recursive_mutex> lock = LockKernel();
           memory.set_kernel_mode();
-          pt_manager.MapProcessPages(user_psw0, vaddr, count);
+          if (options.demand_paging) {
+              pt_manager.ReserveProcessPages(user_psw0, vaddr, count);
+          } else {
+              pt_manager.MapProcessPages(user_psw0, vaddr, count, options.contiguous);
+          }
           memory.load_user_psw0(user_psw0);
       }else {
+          output.Flush();
           cerr << "ERROR: virtual address is not a multiple of page size";
       }
       
   } else {
+       output.Flush();
        cerr << "ERROR: badly formatted command\n";
        exit(2);
   }
@@ -254,17 +1009,33 @@ void Trace::CodeF01(const vector<uint32_t> &hexVals) {
 void Trace::CodeCB1(const vector<uint32_t> &hexVals) {
   // Compare to Specified Values
   mem::Addr addr = hexVals.at(1);
-  uint8_t byte_at_addr; 
-  // Compare specified byte values
-  for (int i = 2; i < hexVals.size(); ++i) {
-    memory.movb(&byte_at_addr, addr);
-    if(byte_at_addr != hexVals.at(i)) {
-      cout << "compare error at address " << hex << setw(8) << setfill('0')
-              << addr
-              << ", expected " << setw(2) << static_cast<uint32_t>(hexVals.at(i))
-              << ", actual is " << setw(2) << static_cast<uint32_t>(byte_at_addr) << "\n";
+  uint32_t count = hexVals.size() - 2;
+  uint8_t bytes[mem::kPageSize];
+  uint8_t expected[mem::kPageSize];
+  
+  // Compare one page-sized piece at a time, so mismatches before a fault
+  // are reported ahead of it
+  for (uint32_t done = 0; done < count; ) {
+    uint32_t chunk = std::min(count - done, kBlockSize - (addr % kBlockSize));
+    uint32_t fetched = ReadBytes(addr, bytes, chunk);
+    const uint32_t *values = hexVals.data() + done + 2;
+    if (compare::Narrow(values, fetched, expected)) {
+      // Skip from mismatch to mismatch
+      for (uint32_t i = compare::FindDifferent(bytes, expected, fetched); i < fetched;
+              i += 1 + compare::FindDifferent(bytes + i + 1, expected + i + 1, fetched - i - 1)) {
+        CompareError(addr + i, values[i], bytes[i]);
+      }
+    } else {
+      // A value over ff never matches
+      for (uint32_t i = 0; i < fetched; ++i) {
+        if(bytes[i] != values[i]) {
+          CompareError(addr + i, values[i], bytes[i]);
+        }
+      }
     }
-    ++addr;
+    if (fetched < chunk) break;  // fault
+    addr += chunk;
+    done += chunk;
   }
 }
 
@@ -273,45 +1044,62 @@ void Trace::CodeCBA(const vector<uint32_t> &hexVals) {
   uint32_t count = hexVals.at(1);
   mem::Addr addr = hexVals.at(2);
   uint32_t val = hexVals.at(3);
-  uint8_t byte_at_addr;
+  uint8_t bytes[mem::kPageSize];
   
-  // Compare specified byte values
-  for (uint32_t i = 0; i < count; ++i) {
-    memory.movb(&byte_at_addr, addr + i);
-    if(byte_at_addr != val) {
-      cout << "compare error at address " << hex << setw(8) << setfill('0')
-              << addr+i
-              << ", expected " << setw(2) << val
-              << ", actual is " << setw(2) << static_cast<uint32_t>(byte_at_addr) << "\n";
+  // Compare one page-sized piece at a time
+  while (count > 0) {
+    uint32_t chunk = std::min(count, kBlockSize - (addr % kBlockSize));
+    uint32_t fetched = ReadBytes(addr, bytes, chunk);
+    if (val <= 0xFF) {
+      // Skip from mismatch to mismatch
+      for (uint32_t i = compare::FindNotEqual(bytes, fetched, val); i < fetched;
+              i += 1 + compare::FindNotEqual(bytes + i + 1, fetched - i - 1, val)) {
+        CompareError(addr + i, val, bytes[i]);
+      }
+    } else {
+      // A value over ff never matches
+      for (uint32_t i = 0; i < fetched; ++i) {
+        CompareError(addr + i, val, bytes[i]);
+      }
     }
+    if (fetched < chunk) break;  // fault
+    addr += chunk;
+    count -= chunk;
   }
 }
 
 void Trace::Code301(const vector<uint32_t> &hexVals) {
   // Store multiple bytes starting at specified address
   mem::Addr addr = hexVals.at(1);
-  for (int i = 2; i < hexVals.size(); ++i) {
-      mem::Addr new_addr = addr++;
-      uint8_t value = hexVals.at(i);
-     memory.movb(new_addr, &value);
-  }
+  vector<uint8_t> bytes(hexVals.begin() + 2, hexVals.end());
+  WriteBytes(addr, bytes.data(), bytes.size());
 }
 
 void Trace::Code31D(const vector<uint32_t> &hexVals) {
   // Replicate Range of Bytes From Source to Destination
-    uint32_t nextTemp = hexVals.at(1);
-    mem::Addr nextTemp1 = hexVals.at(2);
-    mem::Addr nextTemp2 = hexVals.at(3); 
-    uint8_t byte_at_addr;
+  uint32_t count = hexVals.at(1);
+  mem::Addr dest = hexVals.at(2);
+  mem::Addr src = hexVals.at(3);
+  uint8_t bytes[mem::kPageSize];
+  
+  while (count > 0) {
+    // Keep each piece within one source page and one destination page
+    uint32_t chunk = std::min(count, kBlockSize - (src % kBlockSize));
+    chunk = std::min(chunk, kBlockSize - (dest % kBlockSize));
     
-    for (uint32_t i = 0; i < nextTemp; i++) {
-        memory.movb(&byte_at_addr, nextTemp2);
-        memory.movb(nextTemp1, &byte_at_addr);
-
-        nextTemp1++;
-        nextTemp2++;
-
+    // The copy is byte-by-byte from low to high address, so a destination
+    // just above the source replicates the pattern. Never read bytes that
+    // have not yet been written.
+    if (dest > src && dest - src < chunk) {
+      chunk = dest - src;
     }
+    
+    uint32_t fetched = ReadBytes(src, bytes, chunk);
+    if (WriteBytes(dest, bytes, fetched) < chunk) break;  // fault
+    src += chunk;
+    dest += chunk;
+    count -= chunk;
+  }
 }
 
 void Trace::Code30A(const vector<uint32_t> &hexVals) {
@@ -319,35 +1107,229 @@ void Trace::Code30A(const vector<uint32_t> &hexVals) {
   uint8_t value = hexVals.at(3);
   uint32_t count = hexVals.at(1);
   uint32_t addr = hexVals.at(2);
-  for (int i = 0; i < count; ++i) {
-    memory.movb(addr++, &value);
-  }
+  FillBytes(addr, value, count);
 }
 
 void Trace::Code4F0(const vector<uint32_t> &hexVals) {
   // Output bytes
   mem::Addr addr = hexVals.at(2);
   uint32_t count = hexVals.at(1);
-  uint8_t byte_at_addr;
+  uint8_t bytes[mem::kPageSize];
+  
+  // Fetch the range first, one page-sized piece at a time, so a fault is
+  // reported ahead of the output; only bytes before a fault are output
+  uint32_t fetched = 0;
+  uint32_t pieces = 0;
+  while (fetched < count) {
+    uint32_t chunk = std::min(count - fetched, kBlockSize - ((addr + fetched) % kBlockSize));
+    uint32_t moved = ReadBytes(addr + fetched, bytes, chunk);
+    fetched += moved;
+    ++pieces;
+    if (moved < chunk) break;  // fault
+  }
 
-  // Output the specified number of bytes starting at the address
-  for (int i = 0; i < count; ++i) {
-    if ((i % 16) == 0) { // Write new line with address every 16 bytes
-      if (i > 0) cout << "\n";  // not before first line
-      cout << hex << setw(8) << setfill('0') << addr << ": ";
-    } else {
-      cout << ",";
+  if (!options.dump) return;
+
+  // Output the specified number of bytes starting at the address. A single
+  // piece is still in bytes; the pieces of a longer range are read again.
+  OutputSink &out = CommandOutput();
+  for (uint32_t done = 0; done < fetched; ) {
+    uint32_t chunk = std::min(fetched - done, kBlockSize - ((addr + done) % kBlockSize));
+    if (pieces > 1) ReadBytes(addr + done, bytes, chunk);
+    for (uint32_t i = done; i < done + chunk; ++i) {
+      if ((i % 16) == 0) { // Write new line with address every 16 bytes
+        if (i > 0) out.Put('\n');  // not before first line
+        out.Hex(addr + i, 8);
+        out.Write(": ", 2);
+      } else {
+        out.Put(',');
+      }
+      out.HexByte(bytes[i - done]);
     }
-    mem::Addr new_addr = addr++;
-    
-    memory.movb(&byte_at_addr, new_addr);
+    done += chunk;
+  }
+  if (fetched > 0) out.Put('\n');
+}
+
+void Trace::CompareError(mem::Addr addr, uint32_t expected, uint8_t actual) {
+  OutputSink &out = CommandOutput();
+  out.Write("compare error at address ", 25);
+  out.Hex(addr, 8);
+  out.Write(", expected ", 11);
+  out.Hex(expected, 2);
+  out.Write(", actual is ", 12);
+  out.HexByte(actual);
+  out.Put('\n');
+}
+
+OutputSink &Trace::CommandOutput(void) {
+  return (command_output != nullptr) ? *command_output : output;
+}
+
+uint32_t Trace::ReadBytes(mem::Addr addr, uint8_t *data, uint32_t count) {
+  uint32_t done = 0;
+  while (done < count) {
+    uint32_t moved = MoveFromUser(data + done, addr, count - done);
+    if (moved == 0) break;
+    addr += moved;
+    done += moved;
+  }
+  return done;
+}
+
+uint32_t Trace::WriteBytes(mem::Addr addr, const uint8_t *data, uint32_t count) {
+  uint32_t done = 0;
+  while (done < count) {
+    uint32_t moved = MoveToUser(addr, data + done, count - done);
+    if (moved == 0) break;
+    addr += moved;
+    done += moved;
+  }
+  return done;
+}
+
+uint32_t Trace::FillBytes(mem::Addr addr, uint8_t value, uint32_t count) {
+  uint8_t bytes[mem::kPageSize];
+  std::fill(bytes, bytes + sizeof(bytes), value);
+  
+  uint32_t done = 0;
+  while (done < count) {
+    uint32_t chunk = std::min(count - done, kBlockSize - (addr % kBlockSize));
+    if (MoveToUser(addr, bytes, chunk) == 0) break;
+    addr += chunk;
+    done += chunk;
+  }
+  return done;
+}
+
+bool Trace::Writable(mem::Addr addr, uint64_t end) {
+  if (end > uint64_t(UINT32_MAX) + 1) return false;
+  std::unique_lock<std::recursive_mutex> lock = LockKernel();
+  memory.set_kernel_mode();
+  bool writable = true;
+  mem::Addr frame_addr;
+  for (uint64_t page = addr - addr % kBlockSize; page < end && writable; page += kBlockSize) {
+    writable = TranslateCached(page, true, frame_addr);
+  }
+  memory.load_user_psw0(user_psw0);
+  return writable;
+}
+
+uint32_t Trace::MoveFromUser(uint8_t *data, mem::Addr addr, uint32_t count) {
+  std::unique_lock<std::recursive_mutex> lock = LockKernel();
+  mem::Addr frame_addr;
+  memory.set_kernel_mode();
+  uint32_t run = TranslateRun(addr, count, false, frame_addr);
+  if (run > 0) {
+    stats.CountMovb();
+    bool moved = memory.movb(data, frame_addr, run);
+    memory.load_user_psw0(user_psw0);
+    return moved ? run : 0;
+  }
+  memory.load_user_psw0(user_psw0);
+  uint32_t chunk = std::min(count, kBlockSize - (addr % kBlockSize));
+  stats.CountMovb();
+  return memory.movb(data, addr, chunk) ? chunk : 0;
+}
+
+uint32_t Trace::MoveToUser(mem::Addr addr, const uint8_t *data, uint32_t count) {
+  std::unique_lock<std::recursive_mutex> lock = LockKernel();
+  mem::Addr frame_addr;
+  memory.set_kernel_mode();
+  uint32_t run = TranslateRun(addr, count, true, frame_addr);
+  if (run > 0) {
+    stats.CountMovb();
+    bool moved = memory.movb(frame_addr, data, run);
+    memory.load_user_psw0(user_psw0);
+    return moved ? run : 0;
+  }
+  memory.load_user_psw0(user_psw0);
+  uint32_t chunk = std::min(count, kBlockSize - (addr % kBlockSize));
+  stats.CountMovb();
+  return memory.movb(addr, data, chunk) ? chunk : 0;
+}
+
+std::unique_lock<std::recursive_mutex> Trace::LockKernel(void) {
+  bool switched;
+  std::unique_lock<std::recursive_mutex> lock = kernel_lock.Acquire(this, switched);
+  if (switched) {
+    //user psw0
+    memory.load_user_psw0(user_psw0);
     
-    cout << setfill('0') << setw(2)
-            << static_cast<uint32_t> (byte_at_addr);
+    //fault handlers
+    memory.SetPageFaultHandler(page_fault_handler);
+    memory.SetWritePermissionFaultHandler(write_fault_handler);
   }
-  cout << "\n";
+  return lock;
 }
 
+bool Trace::TranslateCached(mem::Addr addr, bool write, mem::Addr &frame_addr) {
+  mem::PageTableEntry pt_entry;
+  if (!pt_manager.LookupPage(user_psw0, addr, pt_entry)) return false;
+  if (write && (pt_entry & mem::kPTE_WritableMask) == 0) return false;
+  
+  // Kernel page table maps all of physical memory at the same addresses
+  frame_addr = ((pt_entry >> mem::kPageSizeBits) << mem::kPageSizeBits)
+          | (addr % mem::kPageSize);
+  return true;
+}
+
+bool Trace::MapOnDemand(mem::Addr vaddr) {
+  memory.set_kernel_mode();
+  bool mapped = pt_manager.MapReservedPage(user_psw0, vaddr)
+          || pt_manager.SwapIn(user_psw0, vaddr);
+  memory.load_user_psw0(user_psw0);
+  return mapped;
+}
+
+bool Trace::CopyOnWrite(mem::Addr vaddr) {
+  memory.set_kernel_mode();
+  bool copied = pt_manager.CopyOnWrite(user_psw0, vaddr)
+          || pt_manager.MarkDirty(user_psw0, vaddr);
+  memory.load_user_psw0(user_psw0);
+  return copied;
+}
+
+uint32_t Trace::TranslateRun(mem::Addr addr, uint32_t count, bool write,
+                             mem::Addr &frame_addr) {
+  if (!TranslateCached(addr, write, frame_addr)) return 0;
+  
+  uint32_t run = std::min(count, kBlockSize - (addr % kBlockSize));
+  mem::Addr next_frame;
+  while (run < count && TranslateCached(addr + run, write, next_frame)
+          && next_frame == frame_addr + run) {
+    run += std::min(count - run, kBlockSize);
+  }
+  return run;
+}
+
+void Trace::CodeF00(const vector<uint32_t> &hexVals) {
+  if (hexVals.size() == 3) {
+      uint32_t count = hexVals.at(1);
+      mem::Addr vaddr = hexVals.at(2);
+      
+      //check to see if vaddr is a multiple of 0x400
+      if(vaddr % 1024 == 0) {
+          if (!InPageTable(vaddr, count)) {
+              output.Flush();
+              cerr << "ERROR: page range is outside the page table\n";
+              exit(2);
+          }
+          std::unique_lock<std::recursive_mutex> lock = LockKernel();
+          memory.set_kernel_mode();
+          pt_manager.UnmapProcessPages(user_psw0, vaddr, count);
+          memory.load_user_psw0(user_psw0);
+      }else {
+          output.Flush();
+          cerr << "ERROR: virtual address is not a multiple of page size";
+      }
+      
+  } else {
+       output.Flush();
+       cerr << "ERROR: badly formatted command\n";
+       exit(2);
+  }
+}
 void Trace::CodeFF0(const std::vector<uint32_t>& hexVals){
     if (hexVals.size() == 3) {
         uint32_t count = hexVals.at(1);
@@ -355,14 +1337,22 @@ void Trace::CodeFF0(const std::vector<uint32_t>& hexVals){
 
         //check to see if vaddr is a multiple of 0x400
         if (vaddr % 1024 == 0) {
+            if (!InPageTable(vaddr, count)) {
+                output.Flush();
+                cerr << "ERROR: page range is outside the page table\n";
+                exit(2);
+            }
+            std::unique_lock<std::recursive_mutex> lock = LockKernel();
             memory.set_kernel_mode();
             pt_manager.SetPageWritePermission(user_psw0, vaddr, count, 0);
             memory.load_user_psw0(user_psw0);
         } else {
+            output.Flush();
             cerr << "ERROR: virtual address is not a multiple of page size";
         }
 
     } else {
+        output.Flush();
         cerr << "ERROR: badly formatted command\n";
         exit(2);
     }
@@ -375,15 +1365,59 @@ void Trace::CodeFF1(const std::vector<uint32_t>& hexVals){
 
         //check to see if vaddr is a multiple of 0x400
         if (vaddr % 1024 == 0) {
+            if (!InPageTable(vaddr, count)) {
+                output.Flush();
+                cerr << "ERROR: page range is outside the page table\n";
+                exit(2);
+            }
+            std::unique_lock<std::recursive_mutex> lock = LockKernel();
             memory.set_kernel_mode();
             pt_manager.SetPageWritePermission(user_psw0, vaddr, count, 1);
             memory.load_user_psw0(user_psw0);
         } else {
+            output.Flush();
             cerr << "ERROR: virtual address is not a multiple of page size";
         }
 
     } else {
+        output.Flush();
         cerr << "ERROR: badly formatted command\n";
         exit(2);
     }
-}
\ No newline at end of file
+}
+
+void Trace::CodeF0F(const std::vector<uint32_t>& hexVals){
+    if (hexVals.size() == 1) {
+        std::unique_lock<std::recursive_mutex> lock = LockKernel();
+        memory.set_kernel_mode();
+        mem::Addr pt_base = pt_manager.ForkProcessPageTable(user_psw0);
+        
+        //continue in the child
+        user_psw0 = UserPsw0(pt_base);
+        process_psw0s.push_back(user_psw0);
+        memory.load_user_psw0(user_psw0);
+    } else {
+        output.Flush();
+        cerr << "ERROR: badly formatted command\n";
+        exit(2);
+    }
+}
+
+void Trace::CodeF05(const std::vector<uint32_t>& hexVals){
+    if (hexVals.size() == 2) {
+        uint32_t process = hexVals.at(1);
+        
+        if (process < process_psw0s.size()) {
+            std::unique_lock<std::recursive_mutex> lock = LockKernel();
+            user_psw0 = process_psw0s[process];
+            memory.load_user_psw0(user_psw0);
+        } else {
+            output.Flush();
+            cerr << "ERROR: no such process\n";
+        }
+    } else {
+        output.Flush();
+        cerr << "ERROR: badly formatted command\n";
+        exit(2);
+    }
+}
@@ -8,24 +8,96 @@
 #define TRACE_H
 
 #include "BitMapAllocator.h"
+#include "Checkpoint.h"
+#include "CompiledTrace.h"
+#include "KernelLock.h"
 #include "ManagePageTable.h"
+#include "OutputSink.h"
+#include "TraceStats.h"
 #include <MMU.h>
 
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+// Trace execution options (defaults give the original behavior)
+struct TraceOptions {
+  // If non-zero, commands are read and parsed on a separate thread, which
+  // may run up to this many commands ahead of execution
+  size_t pipeline_depth = 0;
+  
+  // If non-zero, memory commands (301, 30A, 31D, CB1, CBA, 4F0) whose
+  // address ranges do not conflict with earlier commands still running are
+  // executed concurrently on this many worker threads. Output is kept per
+  // command and written in trace order; all other commands wait for the
+  // commands before them. Not combined with pipeline_depth.
+  size_t parallel_workers = 0;
+  
+  // Fuse adjacent commands before running them: stores to consecutive
+  // addresses become one write, a fill overwritten by the next fill is
+  // skipped, and compares that must match the write before them are only
+  // echoed. Commands are fused only when no fault can occur, so output is
+  // unchanged. Not combined with pipeline_depth or parallel_workers.
+  bool peephole = false;
+  
+  // Echo each trace line before executing it
+  bool echo = true;
+  
+  // Output 4F0 dumps; with echo off, only compare errors and faults remain
+  bool dump = true;
+  
+  // File descriptor receiving the trace output
+  int output_fd = 1;
+  
+  // Back each F01 region with physically contiguous frames when possible
+  bool contiguous = false;
+  
+  // F01 only reserves pages; each is mapped by the page fault handler on
+  // first access
+  bool demand_paging = false;
+  
+  // Time each command and print a JSON statistics report to stderr at the
+  // end of RunTrace
+  bool stats = false;
+  
+  // If not empty, each FC0 command appends a checkpoint of the machine to
+  // this image file (see Checkpoint); otherwise FC0 does nothing
+  std::string checkpoint_file;
+  
+  // If non-zero, a checkpoint is also written after the first command at
+  // or after every checkpoint_every lines. Not combined with
+  // parallel_workers.
+  long checkpoint_every = 0;
+  
+  // If not empty, the machine is restored from the last checkpoint in this
+  // image file, and the trace continues after the line it was taken at.
+  // Checkpoints written to the same file are appended to it.
+  std::string resume_file;
+};
+
 class Trace {
 public:
   /**
    * Constructor - open trace file, initialize processing
    * 
+   * The file may be a text trace or a trace compiled by CompiledTrace.
+   * With options_.resume_file, the machine is restored from a checkpoint
+   * taken while running the same trace file.
+   * 
    * @param file_name_ source of trace commands
+   * @param memory_ MMU, possibly shared with other processes
+   * @param pt_manager_ page table manager, possibly shared
+   * @param kernel_lock_ lock serializing all processes sharing memory_
+   * @param options_ execution options
    */
-  Trace(std::string file_name_, mem::MMU &memory_, ManagePageTable &pt_manager_);
+  Trace(std::string file_name_, mem::MMU &memory_, ManagePageTable &pt_manager_,
+        KernelLock &kernel_lock_, const TraceOptions &options_ = TraceOptions());
   
   /**
-   * Destructor - close trace file, clean up processing
+   * Destructor - close trace file, free the memory and page tables of the
+   *   process and its children
    */
   virtual ~Trace(void);
 
@@ -41,34 +113,310 @@ public:
    */
   void RunTrace(void);
   
+  /**
+   * ParseLine - split a trace text line into command code and arguments
+   * 
+   * Hex values are scanned in place, with the same rules as reading the
+   * line with istringstream and std::hex: scanning stops at the first token
+   * that isn't a hex number. No memory is allocated once hexVals has
+   * grown to the longest line.
+   * 
+   * @param text start of line from trace file
+   * @param text_end end of line (excluding the newline)
+   * @param hexVals returns the command code followed by its arguments;
+   *   comments and blank lines return a single comment code
+   */
+  static void ParseLine(const char *text, const char *text_end,
+                        std::vector<uint32_t> &hexVals);
+  
 private:
+  // Decoded trace command. Buffers are reused from command to command.
+  struct Command {
+    long line_number;
+    std::string text;                // line as read, echoed before execution
+    std::vector<uint32_t> hexVals;   // command code and arguments
+    std::string error;               // read error, reported in place of command
+    uint64_t next_offset;            // trace file position after the command,
+    uint32_t next_record;            //   for checkpoints (Checkpoint::TraceState)
+  };
+  
+  // Execution options
+  TraceOptions options;
+  
   // Trace file
   std::string file_name;
   std::fstream trace;
   long line_number;
   
+  // Read buffer for text trace; lines are parsed in place. Data from
+  // read_pos to read_end has not been consumed yet.
+  std::vector<char> read_buffer;
+  size_t read_pos;
+  size_t read_end;
+  bool read_error;
+  
+  // Trace file offset of the start of read_buffer
+  uint64_t read_offset;
+  
+  // Compiled trace, if the file is in binary form
+  std::unique_ptr<CompiledTrace> compiled;
+  
+  // Buffered trace output (echo, dumps, compare errors and faults)
+  OutputSink output;
+  
   // physical memory
   mem::MMU &memory;
   
   //Manage Page Table
   ManagePageTable &pt_manager;
   
+  // Serializes use of memory and pt_manager with other processes
+  KernelLock &kernel_lock;
+  
   //user psw
   mem:: PSW user_psw0;
   
+  // PSW0 of each address space, by process number: 0 is the original and
+  // F0F adds children. user_psw0 is the one commands run in.
+  std::vector<mem::PSW> process_psw0s;
+  
   //fault handlers
   std::shared_ptr<mem::MMU::FaultHandler> page_fault_handler;
   std::shared_ptr<mem::MMU::FaultHandler> write_fault_handler;
+  
+  // Command counts, bytes and latencies (latencies only with options.stats)
+  TraceStats stats;
+  
+  // Serializes recording command latencies from parallel workers
+  std::mutex stats_mutex;
+  
+  // Bytes of the stores merged by ExecuteFused
+  std::vector<uint8_t> fused_bytes;
+  
+  // Checkpoint image being written, or nullptr; periodic checkpoints are
+  // due at next_checkpoint_line
+  std::unique_ptr<Checkpoint> checkpoint;
+  long next_checkpoint_line;
     
   
   /**
-   * InterpretCommand - interpret next trace file command.
-   *   Aborts program if invalid trace file.
+   * ReadCommand - read and parse next trace file command, without echoing
+   *   or executing it. Safe to call on a thread other than the one running
+   *   commands.
+   * 
+   * @param command returns the command; on a read error, command.error is set
+   * @return true if command read (or error), false if end of file
+   */
+  bool ReadCommand(Command &command);
+  
+  // Echo command line, if echo is on
+  void EchoCommand(const Command &command);
+  
+  /**
+   * ExecuteCommand - echo command line and execute it.
+   *   Aborts program if invalid command or read error.
+   * 
+   * @param command command from ReadCommand
+   */
+  void ExecuteCommand(const Command &command);
+  
+  /**
+   * Resume - restore the machine and trace position from the checkpoint in
+   *   options.resume_file. Called by the constructor with the kernel lock
+   *   held, in kernel mode. Aborts program if it can not be restored.
+   */
+  void Resume(void);
+  
+  /**
+   * WriteCheckpoint - flush the trace output, then append a checkpoint of
+   *   the machine as of the end of a command to the checkpoint image.
+   *   Aborts program if it can not be written.
+   * 
+   * @param command command just executed
+   */
+  void WriteCheckpoint(const Command &command);
+  
+  /**
+   * WriteStats - print the statistics report as one JSON object to stderr.
+   *   Counters of the shared allocator, translation cache and swap cover
+   *   all processes.
+   */
+  void WriteStats(void);
+  
+  /**
+   * RunPipelined - run commands with a reader thread parsing ahead of
+   *   execution through a ring of options.pipeline_depth commands
+   */
+  void RunPipelined(void);
+  
+  /**
+   * RunParallel - run commands on options.parallel_workers threads: a
+   *   window of commands is read ahead, and each memory command starts as
+   *   soon as no earlier unfinished command writes a range it accesses or
+   *   accesses a range it writes. Each command's echo, dumps, compare errors
+   *   and faults go to its own buffer, committed to the trace output in
+   *   order. Other commands run on this thread once all earlier commands
+   *   are done.
+   */
+  void RunParallel(void);
+  
+  /**
+   * RunPeephole - run commands through a window of kPeepholeWindow commands
+   *   read ahead, executing fused commands with ExecuteFused where a rule
+   *   applies
+   */
+  void RunPeephole(void);
+  
+  /**
+   * ExecuteFused - echo and execute commands at the head of the peephole
+   *   window as one, if a rule applies and the write involved can not
+   *   fault
+   * 
+   * @param pending commands read ahead, oldest first
+   * @return number of commands executed, 0 if none
+   */
+  size_t ExecuteFused(const std::vector<const Command *> &pending);
+  
+  /**
+   * CommandOutput - output of the command running on the calling thread:
+   *   its buffer when run by RunParallel, otherwise the trace output
+   * 
+   * @return sink for echo, dumps, compare errors and faults
+   */
+  OutputSink &CommandOutput(void);
+  
+  /**
+   * NextLine - get next line of text trace from the read buffer, refilling
+   *   it as needed.
+   * 
+   * @param text returns start of line in read buffer
+   * @param text_length returns line length, excluding the newline
+   * @return true if a line was read, false if end of file or read error
+   *   (read_error set)
+   */
+  bool NextLine(const char *&text, size_t &text_length);
+  
+  /**
+   * CompareError - output a CB1/CBA mismatch
+   * 
+   * @param addr virtual address of mismatch
+   * @param expected expected value from command
+   * @param actual byte found in memory
+   */
+  void CompareError(mem::Addr addr, uint32_t expected, uint8_t actual);
+  
+  /**
+   * ReadBytes - copy bytes from user virtual memory. The range is split at
+   *   page boundaries, except between pages in adjacent physical frames,
+   *   and each piece is moved with a single movb, so a fault can only occur
+   *   on the first byte of a piece.
+   * 
+   * @param addr starting virtual address
+   * @param data destination buffer, at least count bytes
+   * @param count number of bytes to copy
+   * @return number of bytes copied before a fault (count if no fault)
+   */
+  uint32_t ReadBytes(mem::Addr addr, uint8_t *data, uint32_t count);
+  
+  /**
+   * WriteBytes - copy bytes to user virtual memory, split as ReadBytes.
+   * 
+   * @param addr starting virtual address
+   * @param data source buffer, at least count bytes
+   * @param count number of bytes to copy
+   * @return number of bytes copied before a fault (count if no fault)
+   */
+  uint32_t WriteBytes(mem::Addr addr, const uint8_t *data, uint32_t count);
+  
+  /**
+   * FillBytes - set a range of user virtual memory to a single value
+   * 
+   * @param addr starting virtual address
+   * @param value byte value to store
+   * @param count number of bytes to set
+   * @return number of bytes set before a fault (count if no fault)
+   */
+  uint32_t FillBytes(mem::Addr addr, uint8_t value, uint32_t count);
+  
+  /**
+   * Writable - check that a range of user memory is mapped writable, so
+   *   writing it can not fault
+   * 
+   * @param addr starting virtual address
+   * @param end virtual address after the range, possibly past 4GB
+   * @return true if every page of the range is present and writable
+   */
+  bool Writable(mem::Addr addr, uint64_t end);
+  
+  /**
+   * MoveFromUser/MoveToUser - move the first piece of a range of user
+   *   memory, holding the kernel lock. If the translation cache holds usable
+   *   entries, the piece runs through every following page backed by the
+   *   next physical frame, and is moved directly in kernel mode with one
+   *   movb. Otherwise the piece is the rest of the first page, accessed in
+   *   user mode so that the MMU raises the fault.
+   * 
+   * @param data host buffer
+   * @param addr virtual address
+   * @param count number of bytes in range
+   * @return number of bytes moved, 0 if fault
+   */
+  uint32_t MoveFromUser(uint8_t *data, mem::Addr addr, uint32_t count);
+  uint32_t MoveToUser(mem::Addr addr, const uint8_t *data, uint32_t count);
+  
+  /**
+   * LockKernel - lock the shared MMU and kernel data for this process,
+   *   loading the user PSW0 and fault handlers if another process ran last
+   * 
+   * @return lock, released when destroyed
+   */
+  std::unique_lock<std::recursive_mutex> LockKernel(void);
+  
+  /**
+   * MapOnDemand - map a reserved or swapped out page on a page fault.
+   *   Called by the page fault handler in user mode with the kernel lock
+   *   held; returns in user mode.
+   * 
+   * @param vaddr faulting virtual address
+   * @return true if the page was reserved or swapped out and is now mapped
+   */
+  bool MapOnDemand(mem::Addr vaddr);
+  
+  /**
+   * CopyOnWrite - copy a shared page, or mark a clean swapped in page dirty,
+   *   on a write permission fault. Called as MapOnDemand, by the write
+   *   permission fault handler.
+   * 
+   * @param vaddr faulting virtual address
+   * @return true if the page was copy-on-write or clean and is now writable
+   */
+  bool CopyOnWrite(mem::Addr vaddr);
+  
+  /**
+   * TranslateCached - translate a user address using the page table manager's
+   *   translation cache. Must be called in kernel mode.
+   * 
+   * @param addr virtual address
+   * @param write true if the access is a write
+   * @param frame_addr returns the physical (kernel) address
+   * @return true if the page is present and permits the access
+   */
+  bool TranslateCached(mem::Addr addr, bool write, mem::Addr &frame_addr);
+  
+  /**
+   * TranslateRun - translate the start of a range of user memory, then
+   *   extend it over following pages backed by the next physical frames.
+   *   Must be called in kernel mode.
    * 
-   * @param hexVals returns a vector of the command line values
-   * @return true if command parsed, false if end of file
+   * @param addr virtual address
+   * @param count number of bytes in range
+   * @param write true if the access is a write
+   * @param frame_addr returns the physical (kernel) address of addr
+   * @return number of physically contiguous bytes from addr, up to count;
+   *   0 if the first page can not be translated
    */
-  bool InterpretCommand(std::vector<uint32_t> &hexVals);
+  uint32_t TranslateRun(mem::Addr addr, uint32_t count, bool write,
+                        mem::Addr &frame_addr);
   
   /**
    * Command processors. Arguments are the same for each command.
@@ -76,6 +424,7 @@ private:
    * @param hexVals command code and arguments
    */
   void CodeF01(const std::vector<uint32_t> &hexVals);  // allocate virtual memory
+  void CodeF00(const std::vector<uint32_t> &hexVals);  // free virtual memory
   void CodeCB1(const std::vector<uint32_t> &hexVals);  // Compare to Specified Values
   void CodeCBA(const std::vector<uint32_t> &hexVals);  // Compare Single Value to Memory Range
   void Code301(const std::vector<uint32_t> &hexVals);  // Set Bytes
@@ -84,6 +433,8 @@ private:
   void Code4F0(const std::vector<uint32_t> &hexVals);  // Output Bytes
   void CodeFF1(const std::vector<uint32_t> &hexVals); 
   void CodeFF0(const std::vector<uint32_t> &hexVals); 
+  void CodeF0F(const std::vector<uint32_t> &hexVals);  // Fork Process (copy-on-write)
+  void CodeF05(const std::vector<uint32_t> &hexVals);  // Switch to Process
 };
 
 #endif /* TRACE_H */
@@ -0,0 +1,82 @@
+/*
+ * File:   TraceStats.cpp
+ *
+ * Created on October 17, 2026
+ */
+
+#include "TraceStats.h"
+
+#include <MMU.h>
+
+#include <iomanip>
+
+const size_t TraceStats::kLatencyBuckets;
+
+void TraceStats::RecordCommand(const std::vector<uint32_t> &hexVals,
+                               uint64_t nanoseconds) {
+  OpcodeStats &stats = opcodes[hexVals[0]];
+  ++stats.count;
+  stats.bytes += CommandBytes(hexVals);
+  stats.total_ns += nanoseconds;
+
+  size_t bucket = 0;
+  for (uint64_t us = nanoseconds / 1000; us > 0 && bucket < kLatencyBuckets - 1; us >>= 1) {
+    ++bucket;
+  }
+  ++stats.latency[bucket];
+}
+
+uint64_t TraceStats::CommandBytes(const std::vector<uint32_t> &hexVals) {
+  switch (hexVals[0]) {
+    case 0xF01: case 0xF00: case 0xFF0: case 0xFF1:  // count vaddr
+      return (hexVals.size() > 1) ? uint64_t(hexVals[1]) * mem::kPageSize : 0;
+    case 0xCBA: case 0x30A: case 0x31D: case 0x4F0:  // count ...
+      return (hexVals.size() > 1) ? hexVals[1] : 0;
+    case 0xCB1: case 0x301:                          // addr values...
+      return (hexVals.size() > 2) ? hexVals.size() - 2 : 0;
+    default:
+      return 0;
+  }
+}
+
+void TraceStats::WriteCommandsJson(std::ostringstream &out, int indent) const {
+  std::string pad(indent, ' ');
+  out << "{";
+  const char *separator = "\n";
+  for (const auto &entry : opcodes) {
+    const OpcodeStats &stats = entry.second;
+    out << separator << pad << "\"" << std::hex << std::uppercase
+        << std::setw(3) << std::setfill('0') << entry.first
+        << std::dec << std::nouppercase << std::setfill(' ') << "\": {"
+        << "\"count\": " << stats.count
+        << ", \"bytes\": " << stats.bytes
+        << ", \"total_us\": " << stats.total_ns / 1000
+        << ", \"latency_us\": {";
+
+    // Non-empty buckets, keyed by their upper bound
+    const char *bucket_separator = "";
+    for (size_t i = 0; i < kLatencyBuckets; ++i) {
+      if (stats.latency[i] == 0) continue;
+      out << bucket_separator;
+      if (i == kLatencyBuckets - 1) {
+        out << "\"ge_" << (uint64_t(1) << (i - 1)) << "\": ";
+      } else {
+        out << "\"lt_" << (uint64_t(1) << i) << "\": ";
+      }
+      out << stats.latency[i];
+      bucket_separator = ", ";
+    }
+    out << "}}";
+    separator = ",\n";
+  }
+  if (!opcodes.empty()) {
+    out << "\n" << std::string(indent > 2 ? indent - 2 : 0, ' ');
+  }
+  out << "}";
+}
+
+void TraceStats::WritePeepholeJson(std::ostringstream &out) const {
+  out << "{\"merged_stores\": " << eliminated[kMergedStores]
+      << ", \"shadowed_fills\": " << eliminated[kShadowedFills]
+      << ", \"folded_compares\": " << eliminated[kFoldedCompares] << "}";
+}
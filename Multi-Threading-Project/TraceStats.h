@@ -0,0 +1,106 @@
+/*
+ * File:   TraceStats.h
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef TRACESTATS_H
+#define TRACESTATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * TraceStats - counts, bytes and latency of each trace command opcode run
+ * by one process, with the number of movb calls its commands issued.
+ *
+ * Latencies go in power of 2 microsecond buckets: bucket 0 holds commands
+ * under 1us, bucket i those from 2^(i-1) up to 2^i us, and the last bucket
+ * everything longer.
+ */
+class TraceStats {
+public:
+  static const size_t kLatencyBuckets = 24;
+
+  // Peephole rules, each counting the commands it eliminated
+  enum PeepholeRule {
+    kMergedStores,     // 301 merged into the store before it
+    kShadowedFills,    // 30A skipped, as the next fill overwrites it
+    kFoldedCompares,   // CBA/CB1 known to match the write before it
+    kPeepholeRules
+  };
+
+  TraceStats() : movb_calls(0), eliminated() {}
+
+  virtual ~TraceStats() {}  // empty destructor
+
+  // Disallow copy/move
+  TraceStats(const TraceStats &other) = delete;
+  TraceStats(TraceStats &&other) = delete;
+  TraceStats &operator=(const TraceStats &other) = delete;
+  TraceStats &operator=(TraceStats &&other) = delete;
+
+  /**
+   * RecordCommand - count one executed command
+   *
+   * @param hexVals command code and operands
+   * @param nanoseconds time taken to execute it
+   */
+  void RecordCommand(const std::vector<uint32_t> &hexVals, uint64_t nanoseconds);
+
+  // Count a movb issued on behalf of a command
+  void CountMovb(void) { ++movb_calls; }
+
+  uint64_t get_movb_calls(void) const { return movb_calls; }
+
+  // Count commands eliminated by a peephole rule
+  void CountEliminated(PeepholeRule rule, uint64_t count) { eliminated[rule] += count; }
+
+  uint64_t get_eliminated(PeepholeRule rule) const { return eliminated[rule]; }
+
+  /**
+   * WritePeepholeJson - append a JSON object of commands eliminated by
+   *   each peephole rule
+   *
+   * @param out stream receiving the JSON text
+   */
+  void WritePeepholeJson(std::ostringstream &out) const;
+
+  /**
+   * WriteCommandsJson - append a JSON object with one member per opcode
+   *
+   * @param out stream receiving the JSON text
+   * @param indent spaces before each member
+   */
+  void WriteCommandsJson(std::ostringstream &out, int indent) const;
+
+  /**
+   * CommandBytes - bytes of memory a command covers: the byte count of
+   *   memory commands, or pages times page size for page table commands
+   *
+   * @param hexVals command code and operands
+   * @return bytes covered, 0 if the command does not address memory
+   */
+  static uint64_t CommandBytes(const std::vector<uint32_t> &hexVals);
+
+private:
+  struct OpcodeStats {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    uint64_t total_ns = 0;
+    uint64_t latency[kLatencyBuckets] = {};
+  };
+
+  // By opcode, in opcode order for stable output
+  std::map<uint32_t, OpcodeStats> opcodes;
+
+  uint64_t movb_calls;
+
+  uint64_t eliminated[kPeepholeRules];
+};
+
+#endif /* TRACESTATS_H */
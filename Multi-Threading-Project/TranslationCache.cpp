@@ -0,0 +1,84 @@
+/*
+ * File:   TranslationCache.cpp
+ *
+ * Created on October 17, 2026
+ */
+
+#include "TranslationCache.h"
+
+using mem::Addr;
+using mem::kPageSizeBits;
+
+TranslationCache::TranslationCache()
+: hit_count(0), miss_count(0)
+{
+  for (uint32_t set = 0; set < kSets; ++set) {
+    next_way[set] = 0;
+    for (uint32_t way = 0; way < kWays; ++way) {
+      entries[set][way].valid = false;
+    }
+  }
+}
+
+bool TranslationCache::Lookup(Addr pt_base, Addr vaddr,
+                              mem::PageTableEntry &pt_entry) {
+  Addr vpage = vaddr >> kPageSizeBits;
+  Entry *set = entries[vpage % kSets];
+
+  for (uint32_t way = 0; way < kWays; ++way) {
+    if (set[way].valid && set[way].vpage == vpage
+            && set[way].pt_base == pt_base) {
+      pt_entry = set[way].pt_entry;
+      ++hit_count;
+      return true;
+    }
+  }
+
+  ++miss_count;
+  return false;
+}
+
+void TranslationCache::Insert(Addr pt_base, Addr vaddr,
+                              mem::PageTableEntry pt_entry) {
+  Addr vpage = vaddr >> kPageSizeBits;
+  uint32_t set_num = vpage % kSets;
+  Entry *set = entries[set_num];
+
+  // Reuse the way already holding this page, else the next victim
+  uint32_t way;
+  for (way = 0; way < kWays; ++way) {
+    if (set[way].valid && set[way].vpage == vpage
+            && set[way].pt_base == pt_base) break;
+  }
+  if (way == kWays) {
+    way = next_way[set_num];
+    next_way[set_num] = (way + 1) % kWays;
+  }
+
+  set[way].valid = true;
+  set[way].pt_base = pt_base;
+  set[way].vpage = vpage;
+  set[way].pt_entry = pt_entry;
+}
+
+void TranslationCache::Invalidate(Addr pt_base, Addr vaddr) {
+  Addr vpage = vaddr >> kPageSizeBits;
+  Entry *set = entries[vpage % kSets];
+
+  for (uint32_t way = 0; way < kWays; ++way) {
+    if (set[way].valid && set[way].vpage == vpage
+            && set[way].pt_base == pt_base) {
+      set[way].valid = false;
+    }
+  }
+}
+
+void TranslationCache::InvalidateAll(Addr pt_base) {
+  for (uint32_t set = 0; set < kSets; ++set) {
+    for (uint32_t way = 0; way < kWays; ++way) {
+      if (entries[set][way].pt_base == pt_base) {
+        entries[set][way].valid = false;
+      }
+    }
+  }
+}
@@ -0,0 +1,90 @@
+/*
+ * File:   TranslationCache.h
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef TRANSLATIONCACHE_H
+#define TRANSLATIONCACHE_H
+
+#include <MMU.h>
+
+#include <cstdint>
+
+class TranslationCache {
+public:
+  /**
+   * Constructor - create an empty cache
+   */
+  TranslationCache();
+
+  virtual ~TranslationCache() {}  // empty destructor
+
+  // Disallow copy/move
+  TranslationCache(const TranslationCache &other) = delete;
+  TranslationCache(TranslationCache &&other) = delete;
+  TranslationCache &operator=(const TranslationCache &other) = delete;
+  TranslationCache &operator=(TranslationCache &&other) = delete;
+
+  /**
+   * Lookup - find cached page table entry for a virtual page
+   *
+   * @param pt_base kernel address of the process page table
+   * @param vaddr any virtual address in the page
+   * @param pt_entry returns the cached page table entry on a hit
+   * @return true if hit, false if miss
+   */
+  bool Lookup(mem::Addr pt_base, mem::Addr vaddr, mem::PageTableEntry &pt_entry);
+
+  /**
+   * Insert - cache a present page table entry, replacing the oldest way
+   *   of its set
+   *
+   * @param pt_base kernel address of the process page table
+   * @param vaddr any virtual address in the page
+   * @param pt_entry page table entry to cache
+   */
+  void Insert(mem::Addr pt_base, mem::Addr vaddr, mem::PageTableEntry pt_entry);
+
+  /**
+   * Invalidate - drop the entry for one virtual page, if cached
+   *
+   * @param pt_base kernel address of the process page table
+   * @param vaddr any virtual address in the page
+   */
+  void Invalidate(mem::Addr pt_base, mem::Addr vaddr);
+
+  /**
+   * InvalidateAll - drop every entry for a page table
+   *
+   * @param pt_base kernel address of the process page table
+   */
+  void InvalidateAll(mem::Addr pt_base);
+
+  // Functions to return counters
+  uint64_t get_hit_count(void) const { return hit_count; }
+  uint64_t get_miss_count(void) const { return miss_count; }
+
+private:
+  // Cache geometry; virtual page number selects the set
+  static const uint32_t kSets = 16;
+  static const uint32_t kWays = 4;
+
+  struct Entry {
+    bool valid;
+    mem::Addr pt_base;
+    mem::Addr vpage;
+    mem::PageTableEntry pt_entry;
+  };
+
+  Entry entries[kSets][kWays];
+
+  // Next way to replace in each set (round robin)
+  uint32_t next_way[kSets];
+
+  uint64_t hit_count;
+  uint64_t miss_count;
+};
+
+#endif /* TRANSLATIONCACHE_H */
+
@@ -0,0 +1,98 @@
+/*
+ * File:   AllocatorBench.cpp
+ *
+ * Created on October 17, 2026
+ *
+ * Locking overhead benchmark: GetFrames/FreeFrames operations per second
+ * from 1 to 32 threads, with the allocator behind one global mutex taken by
+ * the caller and in thread-safe mode, where it takes the recursive kernel
+ * lock itself. Both serialize every call, so this is not a scaling
+ * benchmark; it shows what the allocator's own locking costs as threads
+ * contend.
+ *
+ * usage: AllocatorBench [operations_per_thread]
+ */
+
+#include "BitMapAllocator.h"
+#include "KernelLock.h"
+
+#include <MMU.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+  const uint32_t kFrameCount = 256;
+  const int kThreadCounts[] = { 1, 2, 4, 8, 16, 32 };
+
+  // Allocate and free 1 to 4 frames at a time, holding up to 4 allocations
+  void Worker(BitMapAllocator &allocator, std::mutex *global_lock,
+              long operations, unsigned seed) {
+    std::vector<std::vector<mem::Addr>> held(4);
+    for (long i = 0; i < operations; ++i) {
+      seed = seed * 1103515245 + 12345;
+      std::vector<mem::Addr> &frames = held[(seed >> 8) % held.size()];
+      uint32_t count = frames.empty() ? 1 + (seed >> 16) % 4 : frames.size();
+      std::unique_lock<std::mutex> lock;
+      if (global_lock != nullptr) lock = std::unique_lock<std::mutex>(*global_lock);
+      if (frames.empty()) {
+        allocator.GetFrames(count, frames);  // may fail when memory is short
+      } else {
+        allocator.FreeFrames(count, frames);
+      }
+    }
+    for (std::vector<mem::Addr> &frames : held) {
+      std::unique_lock<std::mutex> lock;
+      if (global_lock != nullptr) lock = std::unique_lock<std::mutex>(*global_lock);
+      allocator.FreeFrames(frames.size(), frames);
+    }
+  }
+
+  // Operations per second for one run
+  double Run(int threads, bool thread_safe, long operations) {
+    mem::MMU memory(kFrameCount);
+    BitMapAllocator allocator(memory);
+    KernelLock kernel_lock;
+    std::mutex global_lock;
+    if (thread_safe) allocator.EnableThreadSafe(kernel_lock);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+      workers.emplace_back(Worker, std::ref(allocator),
+                           thread_safe ? nullptr : &global_lock, operations, t + 1);
+    }
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+    double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+    if (allocator.get_free_count() != kFrameCount - 1) {
+      std::cerr << "ERROR: frames lost with " << threads << " threads\n";
+      exit(1);
+    }
+    return threads * operations / seconds;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  long operations = (argc > 1) ? atol(argv[1]) : 20000;
+
+  std::cout << std::setw(8) << "threads" << std::setw(16) << "locked ops/s"
+            << std::setw(19) << "thread-safe ops/s" << std::setw(10) << "ratio" << "\n";
+  for (int threads : kThreadCounts) {
+    double locked_rate = Run(threads, false, operations);
+    double thread_safe_rate = Run(threads, true, operations);
+    std::cout << std::setw(8) << threads << std::fixed
+              << std::setprecision(0) << std::setw(16) << locked_rate
+              << std::setw(19) << thread_safe_rate
+              << std::setprecision(2) << std::setw(9) << thread_safe_rate / locked_rate << "x\n";
+  }
+  return 0;
+}
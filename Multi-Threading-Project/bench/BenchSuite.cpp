@@ -0,0 +1,318 @@
+/*
+ * File:   BenchSuite.cpp
+ *
+ * Created on October 17, 2026
+ *
+ * Benchmark suite: BitMapAllocator GetFrames/FreeFrames, ManagePageTable
+ * MapProcessPages and SetPageWritePermission, and Trace throughput of the
+ * 30A, 31D, CBA and 4F0 commands, and the CBA/CB1 compare kernels, each
+ * over a sweep of sizes. Every case is
+ * timed as a number of samples, and the minimum, median and 99th
+ * percentile are printed as a table and optionally written as JSON so that
+ * runs can be compared over time.
+ *
+ * usage: BenchSuite [--samples=count] [--json=file] [--filter=prefix]
+ */
+
+#include "BitMapAllocator.h"
+#include "CompareKernels.h"
+#include "KernelLock.h"
+#include "ManagePageTable.h"
+#include "Trace.h"
+
+#include <MMU.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+  const size_t kDefaultSamples = 30;
+
+  // Operations timed together as one allocator or page table sample
+  const long kBatch = 1000;
+
+  // Commands in each trace run as one Trace sample, and the region they use
+  const int kTraceCommands = 16;
+  const uint32_t kTraceRegionPages = 128;
+
+  const mem::Addr kPageTableEntries = mem::kPageTableSizeBytes / sizeof(mem::PageTableEntry);
+
+  // Summary of one benchmark case
+  struct Result {
+    std::string name;     // what is measured
+    std::string param;    // size swept
+    std::string unit;
+    double min;
+    double median;
+    double p99;
+    size_t samples;
+  };
+
+  // Summarize sample times. For throughput cases, rate_work is the work
+  // done per sample and each statistic of the time is reported as
+  // rate_work / time, so "min" is the rate of the fastest sample and "p99"
+  // that of the 99th percentile time (the slow tail).
+  Result Summarize(const std::string &name, const std::string &param,
+                   const std::string &unit, std::vector<double> times,
+                   double rate_work = 0) {
+    std::sort(times.begin(), times.end());
+    size_t n = times.size();
+    size_t p99 = (n * 99 + 99) / 100;  // nearest rank
+    double stats[] = { times[0], times[(n - 1) / 2], times[p99 - 1] };
+    if (rate_work != 0) {
+      for (double &stat : stats) stat = rate_work / stat;
+    }
+    return Result{ name, param, unit, stats[0], stats[1], stats[2], n };
+  }
+
+  double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  mem::PSW UserPsw0(mem::Addr pt_base) {
+    return static_cast<mem::PSW>(pt_base >> mem::kPageSizeBits) << mem::kPSW0_PageTableShift;
+  }
+
+  // GetFrames/FreeFrames pair, ns, for memory sizes and frames per call
+  void AllocatorCases(size_t samples, std::vector<Result> &results) {
+    for (uint32_t frame_count : { 256u, 4096u, 65536u }) {
+      for (uint32_t count : { 1u, 16u }) {
+        mem::MMU memory(frame_count);
+        BitMapAllocator allocator(memory);
+        std::vector<mem::Addr> frames;
+        std::vector<double> times;
+        for (size_t s = 0; s < samples; ++s) {
+          auto start = std::chrono::steady_clock::now();
+          for (long i = 0; i < kBatch; ++i) {
+            allocator.GetFrames(count, frames);
+            allocator.FreeFrames(count, frames);
+          }
+          times.push_back(Seconds(start) * 1e9 / kBatch);
+        }
+        std::ostringstream param;
+        param << "frames=" << frame_count << ",count=" << count;
+        results.push_back(Summarize("allocator.get_free", param.str(), "ns", times));
+      }
+    }
+  }
+
+  // MapProcessPages of a fresh page table and SetPageWritePermission, us
+  void PageTableCases(size_t samples, std::vector<Result> &results) {
+    mem::MMU memory(4096);
+    BitMapAllocator allocator(memory);
+    ManagePageTable pt_manager(memory, allocator);
+    memory.set_kernel_mode();
+    for (mem::Addr count : { mem::Addr(1), mem::Addr(16), mem::Addr(64), kPageTableEntries }) {
+      std::vector<double> map_times;
+      std::vector<double> protect_times;
+      for (size_t s = 0; s < samples; ++s) {
+        mem::PSW psw0 = UserPsw0(pt_manager.CreateProcessPageTable());
+        auto start = std::chrono::steady_clock::now();
+        pt_manager.MapProcessPages(psw0, 0, count);
+        map_times.push_back(Seconds(start) * 1e6);
+
+        start = std::chrono::steady_clock::now();
+        for (int writable = 0; writable < 2; ++writable) {
+          pt_manager.SetPageWritePermission(psw0, 0, count, writable);
+        }
+        protect_times.push_back(Seconds(start) * 1e6 / 2);
+        pt_manager.DestroyProcessPageTable(psw0);
+      }
+      std::ostringstream param;
+      param << "pages=" << count;
+      results.push_back(Summarize("page_table.map", param.str(), "us", map_times));
+      results.push_back(Summarize("page_table.protect", param.str(), "us", protect_times));
+    }
+  }
+
+  // Trace command throughput, MB/s: each sample runs a trace mapping a
+  // region, then kTraceCommands commands of one opcode
+  void TraceCases(size_t samples, std::vector<Result> &results) {
+    mem::MMU memory(1024);
+    BitMapAllocator allocator(memory);
+    ManagePageTable pt_manager(memory, allocator);
+    KernelLock kernel_lock;
+    int null_fd = open("/dev/null", O_WRONLY);
+
+    TraceOptions options;
+    options.echo = false;
+    options.output_fd = null_fd;
+
+    const char *opcodes[] = { "30A", "31D", "CBA", "4F0" };
+    for (const char *opcode : opcodes) {
+      for (uint32_t bytes : { 0x400u, 0x4000u, 0x10000u }) {
+        // Commands cover the first half of the region; 31D copies from the
+        // second half
+        char file_name[] = "/tmp/BenchSuiteXXXXXX";
+        int fd = mkstemp(file_name);
+        if (fd < 0) {
+          std::cerr << "ERROR: failed to create temporary trace\n";
+          exit(2);
+        }
+        close(fd);
+        {
+          std::ofstream trace(file_name);
+          trace << "F01 " << std::hex << kTraceRegionPages << " 0\n";
+          for (int i = 0; i < kTraceCommands; ++i) {
+            trace << opcode << " " << bytes << " 0";
+            if (strcmp(opcode, "30A") == 0) trace << " " << (i & 0xFF);
+            if (strcmp(opcode, "31D") == 0) trace << " " << kTraceRegionPages * mem::kPageSize / 2;
+            if (strcmp(opcode, "CBA") == 0) trace << " 0";
+            trace << "\n";
+          }
+        }
+
+        std::vector<double> times;
+        for (size_t s = 0; s < samples; ++s) {
+          auto start = std::chrono::steady_clock::now();
+          {
+            Trace process(file_name, memory, pt_manager, kernel_lock, options);
+            process.RunTrace();
+          }
+          times.push_back(Seconds(start));
+        }
+        unlink(file_name);
+
+        std::ostringstream name, param;
+        name << "trace." << opcode;
+        param << "bytes=" << bytes;
+        results.push_back(Summarize(name.str(), param.str(), "MB/s", times,
+                                    double(bytes) * kTraceCommands / 1e6));
+      }
+    }
+    close(null_fd);
+  }
+
+  // Compare kernel throughput, GB/s: FindNotEqual (CBA) and FindDifferent
+  // (CB1) over a matching buffer, for each kernel this CPU supports
+  void CompareCases(size_t samples, std::vector<Result> &results) {
+    const compare::Kernel best = compare::Best();
+    const compare::Kernel kernels[] = {
+      compare::Kernel::kScalar, compare::Kernel::kSse2, compare::Kernel::kAvx2
+    };
+    for (compare::Kernel kernel : kernels) {
+      if (kernel > best) break;
+      compare::Select(kernel);
+      for (size_t bytes : { size_t(64), size_t(mem::kPageSize), size_t(0x10000) }) {
+        std::vector<uint8_t> data(bytes, 0x5A);
+        std::vector<uint8_t> expected(bytes, 0x5A);
+        long repeat = std::max(1L, 0x1000000L / long(bytes));
+        std::vector<double> find_times;
+        std::vector<double> different_times;
+        size_t found = 0;
+        for (size_t s = 0; s < samples; ++s) {
+          auto start = std::chrono::steady_clock::now();
+          for (long i = 0; i < repeat; ++i) {
+            found += compare::FindNotEqual(data.data(), bytes, 0x5A);
+          }
+          find_times.push_back(Seconds(start));
+
+          start = std::chrono::steady_clock::now();
+          for (long i = 0; i < repeat; ++i) {
+            found += compare::FindDifferent(data.data(), expected.data(), bytes);
+          }
+          different_times.push_back(Seconds(start));
+        }
+        if (found != bytes * repeat * samples * 2) {
+          std::cerr << "ERROR: " << compare::Name(kernel) << " kernel found a mismatch\n";
+          exit(2);
+        }
+        std::ostringstream param;
+        param << compare::Name(kernel) << ",bytes=" << bytes;
+        double work = double(bytes) * repeat / 1e9;
+        results.push_back(Summarize("compare.not_equal", param.str(), "GB/s", find_times, work));
+        results.push_back(Summarize("compare.different", param.str(), "GB/s", different_times,
+                                    work));
+      }
+    }
+    compare::Select(best);
+  }
+
+  void WriteJson(const std::string &file_name, const std::vector<Result> &results) {
+    std::ofstream out(file_name);
+    out << "{\n  \"timestamp\": " << time(nullptr) << ",\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+      const Result &r = results[i];
+      out << (i > 0 ? ",\n" : "\n") << "    {\"name\": \"" << r.name
+          << "\", \"param\": \"" << r.param << "\", \"unit\": \"" << r.unit
+          << "\", \"min\": " << r.min << ", \"median\": " << r.median
+          << ", \"p99\": " << r.p99 << ", \"samples\": " << r.samples << "}";
+    }
+    out << "\n  ]\n}\n";
+    if (!out) {
+      std::cerr << "ERROR: failed to write " << file_name << "\n";
+      exit(2);
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+  size_t samples = kDefaultSamples;
+  std::string json_file;
+  std::string filter;
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--samples=", 10) == 0) {
+      samples = strtoul(argv[i] + 10, nullptr, 0);
+    } else if (strncmp(argv[i], "--json=", 7) == 0) {
+      json_file = argv[i] + 7;
+    } else if (strncmp(argv[i], "--filter=", 9) == 0) {
+      filter = argv[i] + 9;
+    } else {
+      samples = 0;
+    }
+  }
+  if (samples == 0) {
+    std::cerr << "usage: BenchSuite [--samples=count] [--json=file] [--filter=prefix]\n";
+    return 2;
+  }
+
+  // A group runs if the filter could match one of its case names
+  // ("trace.CBA" runs the trace group, then keeps only the CBA cases)
+  struct Group {
+    const char *prefix;
+    std::function<void(size_t, std::vector<Result> &)> run;
+  };
+  const Group groups[] = {
+    { "allocator", AllocatorCases },
+    { "page_table", PageTableCases },
+    { "trace", TraceCases },
+    { "compare", CompareCases },
+  };
+  std::vector<Result> results;
+  for (const Group &group : groups) {
+    std::string prefix = group.prefix;
+    if (prefix.compare(0, filter.size(), filter) == 0
+            || filter.compare(0, prefix.size(), prefix) == 0) {
+      group.run(samples, results);
+    }
+  }
+  results.erase(std::remove_if(results.begin(), results.end(), [&](const Result &r) {
+    return r.name.compare(0, filter.size(), filter) != 0;
+  }), results.end());
+
+  std::cout << std::left << std::setw(22) << "name" << std::setw(24) << "param"
+            << std::right << std::setw(12) << "min" << std::setw(12) << "median"
+            << std::setw(12) << "p99" << "  unit\n";
+  for (const Result &r : results) {
+    std::cout << std::left << std::setw(22) << r.name << std::setw(24) << r.param
+              << std::right << std::fixed << std::setprecision(2)
+              << std::setw(12) << r.min << std::setw(12) << r.median
+              << std::setw(12) << r.p99 << "  " << r.unit << "\n";
+  }
+  if (!json_file.empty()) WriteJson(json_file, results);
+  return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * File:   FrameSearchBench.cpp
+ *
+ * Created on October 17, 2026
+ *
+ * Microbenchmark: allocator startup time, and latency of single frame
+ * GetFrames/FreeFrames pairs with memory nearly full, as the number of page
+ * frames grows. With the summary bit map, the search cost should stay
+ * nearly flat.
+ *
+ * usage: FrameSearchBench [operations]
+ */
+
+#include "BitMapAllocator.h"
+
+#include <MMU.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace {
+  // Frames left free while timing, scattered through memory
+  const uint32_t kFreeFrames = 8;
+
+  // Fills in microseconds to build the allocator and mean nanoseconds per
+  // GetFrames/FreeFrames pair
+  void Run(uint32_t frame_count, long operations, double &startup_us,
+           double &pair_ns) {
+    mem::MMU memory(frame_count);
+    auto start = std::chrono::steady_clock::now();
+    BitMapAllocator allocator(memory);
+    startup_us = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count();
+
+    // Take every frame, then free a few spread out so the search must skip
+    // long stretches of full words
+    std::vector<mem::Addr> held;
+    allocator.GetFrames(allocator.get_free_count(), held);
+    std::vector<mem::Addr> spread;
+    for (uint32_t i = 0; i < kFreeFrames; ++i) {
+      spread.push_back(held[(held.size() - 1) * (i + 1) / kFreeFrames]);
+    }
+    allocator.FreeFrames(spread.size(), spread);
+
+    std::vector<mem::Addr> frames;
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < operations; ++i) {
+      allocator.GetFrames(1, frames);
+      allocator.FreeFrames(1, frames);
+    }
+    pair_ns = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count() / operations;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  long operations = (argc > 1) ? atol(argv[1]) : 100000;
+  if (operations <= 0) {
+    std::cerr << "ERROR: operations must be positive\n";
+    return 2;
+  }
+
+  std::cout << std::setw(10) << "frames" << std::setw(14) << "startup us"
+            << std::setw(14) << "get+free ns" << "\n";
+  for (uint32_t frame_count = 256; frame_count <= 262144; frame_count *= 4) {
+    double startup_us, pair_ns;
+    Run(frame_count, operations, startup_us, pair_ns);
+    std::cout << std::setw(10) << frame_count << std::fixed << std::setprecision(1)
+              << std::setw(14) << startup_us << std::setw(14) << pair_ns << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * File:   FrameZeroBench.cpp
+ *
+ * Created on October 17, 2026
+ *
+ * Microbenchmark: latency of large GetFrames calls (as made by F01) when
+ * freed frames are zeroed in bulk on the freeing thread and when they are
+ * zeroed on a background thread, with the zero pool hit rate of each.
+ *
+ * usage: FrameZeroBench [iterations] [frames_per_call] [idle_us]
+ */
+
+#include "BitMapAllocator.h"
+#include "KernelLock.h"
+
+#include <MMU.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+  const uint32_t kFrameCount = 256;
+
+  // Mean microseconds per GetFrames call; fills in hit rate
+  double Run(bool background, long iterations, uint32_t count, long idle_us,
+             double &hit_rate) {
+    KernelLock kernel_lock;  // outlives the zeroing thread
+    mem::MMU memory(kFrameCount);
+    BitMapAllocator allocator(memory);
+    if (background) allocator.StartZeroing(kernel_lock);
+
+    std::vector<uint8_t> junk(mem::kPageSize, 0xA5);
+    std::vector<mem::Addr> frames;
+    double seconds = 0;
+    for (long i = 0; i < iterations; ++i) {
+      {
+        std::unique_lock<std::recursive_mutex> lock = kernel_lock.Acquire();
+        memory.set_kernel_mode();
+        auto start = std::chrono::steady_clock::now();
+        if (!allocator.GetFrames(count, frames)) {
+          std::cerr << "ERROR: GetFrames failed\n";
+          exit(1);
+        }
+        seconds += std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+
+        // Dirty the frames, as a process would
+        for (mem::Addr frame : frames) {
+          memory.movb(frame, junk.data(), mem::kPageSize);
+        }
+        allocator.FreeFrames(frames.size(), frames);
+      }
+      // Time between allocations, in which the background thread can run
+      std::this_thread::sleep_for(std::chrono::microseconds(idle_us));
+    }
+
+    uint64_t hits = allocator.get_zero_pool_hits();
+    uint64_t misses = allocator.get_zero_pool_misses();
+    hit_rate = (hits + misses > 0) ? double(hits) / (hits + misses) : 0;
+    return seconds * 1e6 / iterations;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  long iterations = (argc > 1) ? atol(argv[1]) : 200;
+  uint32_t count = (argc > 2) ? atol(argv[2]) : 128;
+  long idle_us = (argc > 3) ? atol(argv[3]) : 2000;
+  if (count == 0 || count >= kFrameCount) {
+    std::cerr << "ERROR: frames_per_call must be 1 to " << kFrameCount - 1 << "\n";
+    return 2;
+  }
+
+  std::cout << std::left << std::setw(12) << "zeroing" << std::right
+            << std::setw(18) << "GetFrames us" << std::setw(12) << "hit rate" << "\n";
+  const char *names[] = { "inline", "background" };
+  for (int background = 0; background < 2; ++background) {
+    double hit_rate;
+    double latency = Run(background != 0, iterations, count, idle_us, hit_rate);
+    std::cout << std::left << std::setw(12) << names[background] << std::right
+              << std::fixed << std::setprecision(1) << std::setw(18) << latency
+              << std::setw(11) << hit_rate * 100 << "%\n";
+  }
+  return 0;
+}
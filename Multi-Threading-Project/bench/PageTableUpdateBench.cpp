@@ -0,0 +1,128 @@
+/*
+ * File:   PageTableUpdateBench.cpp
+ *
+ * Created on October 17, 2026
+ *
+ * Microbenchmark: mapping a range of pages and changing its write
+ * permission with the range-based page table update path, compared with
+ * reading and writing each page table entry with its own movb.
+ *
+ * usage: PageTableUpdateBench [iterations] [pages]
+ */
+
+#include "BitMapAllocator.h"
+#include "ManagePageTable.h"
+
+#include <MMU.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace {
+  // Enough frames for a fresh page table and mapping per iteration
+  const uint32_t kFrameCount = 0x10000;
+
+  const mem::Addr kPageTableEntries = mem::kPageTableSizeBytes / sizeof(mem::PageTableEntry);
+
+  mem::PSW UserPsw0(mem::Addr pt_base) {
+    return static_cast<mem::PSW>(pt_base >> mem::kPageSizeBits) << mem::kPSW0_PageTableShift;
+  }
+
+  // Per-entry map, as MapProcessPages did before range updates
+  void MapEachEntry(mem::MMU &memory, BitMapAllocator &allocator,
+                    mem::Addr pt_base, size_t count) {
+    std::vector<mem::Addr> page_frames;
+    if (!allocator.GetFrames(count, page_frames)) {
+      std::cerr << "ERROR: GetFrames failed\n";
+      exit(1);
+    }
+    size_t next_frame = 0;
+    for (size_t i = 0; i < count; ++i) {
+      mem::PageTableEntry pt_entry;
+      mem::Addr pte_addr = pt_base + i * sizeof(pt_entry);
+      memory.movb(&pt_entry, pte_addr, sizeof(pt_entry));
+      if ((pt_entry & mem::kPTE_PresentMask) == 0) {
+        pt_entry = page_frames[next_frame++] | mem::kPTE_PresentMask | mem::kPTE_WritableMask;
+        memory.movb(pte_addr, &pt_entry, sizeof(pt_entry));
+      }
+    }
+  }
+
+  // Per-entry permission change
+  void ProtectEachEntry(mem::MMU &memory, mem::Addr pt_base, size_t count,
+                        bool writable) {
+    for (size_t i = 0; i < count; ++i) {
+      mem::PageTableEntry pt_entry;
+      mem::Addr pte_addr = pt_base + i * sizeof(pt_entry);
+      memory.movb(&pt_entry, pte_addr, sizeof(pt_entry));
+      if ((pt_entry & mem::kPTE_PresentMask) != 0) {
+        pt_entry = writable ? (pt_entry | mem::kPTE_WritableMask)
+                            : (pt_entry & ~mem::kPTE_WritableMask);
+        memory.movb(pte_addr, &pt_entry, sizeof(pt_entry));
+      }
+    }
+  }
+
+  // Mean microseconds per map and per permission change; fills in both
+  void Run(bool ranged, long iterations, size_t count, double &map_us,
+           double &protect_us) {
+    mem::MMU memory(kFrameCount);
+    BitMapAllocator allocator(memory);
+    ManagePageTable pt_manager(memory, allocator);
+    memory.set_kernel_mode();
+
+    double map_seconds = 0;
+    double protect_seconds = 0;
+    for (long i = 0; i < iterations; ++i) {
+      mem::Addr pt_base = pt_manager.CreateProcessPageTable();
+      mem::PSW psw0 = UserPsw0(pt_base);
+
+      auto start = std::chrono::steady_clock::now();
+      if (ranged) {
+        pt_manager.MapProcessPages(psw0, 0, count);
+      } else {
+        MapEachEntry(memory, allocator, pt_base, count);
+      }
+      auto mapped = std::chrono::steady_clock::now();
+      for (int writable = 0; writable < 2; ++writable) {
+        if (ranged) {
+          pt_manager.SetPageWritePermission(psw0, 0, count, writable);
+        } else {
+          ProtectEachEntry(memory, pt_base, count, writable != 0);
+        }
+      }
+      auto protected_ = std::chrono::steady_clock::now();
+
+      map_seconds += std::chrono::duration<double>(mapped - start).count();
+      protect_seconds += std::chrono::duration<double>(protected_ - mapped).count();
+    }
+    map_us = map_seconds * 1e6 / iterations;
+    protect_us = protect_seconds * 1e6 / (2 * iterations);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  long iterations = (argc > 1) ? atol(argv[1]) : 100;
+  size_t count = (argc > 2) ? atol(argv[2]) : kPageTableEntries;
+  if (count == 0 || count > kPageTableEntries
+          || iterations <= 0 || iterations * (count + 1) >= kFrameCount) {
+    std::cerr << "ERROR: pages must be 1 to " << kPageTableEntries
+              << " and iterations * (pages + 1) below " << kFrameCount << "\n";
+    return 2;
+  }
+
+  std::cout << std::left << std::setw(12) << "path" << std::right
+            << std::setw(12) << "map us" << std::setw(14) << "protect us" << "\n";
+  const char *names[] = { "per-entry", "range" };
+  for (int ranged = 0; ranged < 2; ++ranged) {
+    double map_us, protect_us;
+    Run(ranged != 0, iterations, count, map_us, protect_us);
+    std::cout << std::left << std::setw(12) << names[ranged] << std::right
+              << std::fixed << std::setprecision(2)
+              << std::setw(12) << map_us << std::setw(14) << protect_us << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * File:   ParseBench.cpp
+ *
+ * Created on October 17, 2026
+ *
+ * Microbenchmark: trace lines parsed per second by the original
+ * getline/istringstream parser and by Trace::ParseLine.
+ *
+ * usage: ParseBench [repetitions] [trace_file...]
+ */
+
+#include "Trace.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+  const uint32_t kComment = 0xFFFFFFFF;
+
+  const char *kDefaultTraces[] = {
+    "trace1v.txt", "trace2v_multi-page.txt", "trace3v_edge-addr.txt",
+    "trace4v_wprotect.txt", "trace5v_pagefaults.txt"
+  };
+
+  // Parser as it was in Trace::InterpretCommand, reading from a stream
+  size_t LegacyParse(std::istream &in, uint64_t &checksum) {
+    size_t lines = 0;
+    std::string textLine;
+    while (getline(in, textLine)) {
+      ++lines;
+      std::vector<uint32_t> hexVals;
+      if (textLine.empty() || textLine[0] == '*') {
+        hexVals.push_back(kComment);
+      } else {
+        std::istringstream lineStream(textLine);
+        uint32_t hVal;
+        while (lineStream >> std::hex >> hVal) {
+          hexVals.push_back(hVal);
+        }
+        if (hexVals.empty()) hexVals.push_back(kComment);
+      }
+      checksum += hexVals.size() + hexVals.back();
+    }
+    return lines;
+  }
+
+  // Buffer scan with Trace::ParseLine and reused argument storage
+  size_t BufferParse(const std::string &buffer, std::vector<uint32_t> &hexVals,
+                     uint64_t &checksum) {
+    size_t lines = 0;
+    const char *next = buffer.data();
+    const char *end = next + buffer.size();
+    while (next != end) {
+      const char *newline = static_cast<const char *>(memchr(next, '\n', end - next));
+      const char *line_end = (newline != nullptr) ? newline : end;
+      ++lines;
+      Trace::ParseLine(next, line_end, hexVals);
+      checksum += hexVals.size() + hexVals.back();
+      next = (newline != nullptr) ? newline + 1 : end;
+    }
+    return lines;
+  }
+
+  double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+int main(int argc, char* argv[]) {
+  long repetitions = (argc > 1) ? atol(argv[1]) : 2000;
+  std::vector<std::string> files;
+  for (int i = 2; i < argc; ++i) files.push_back(argv[i]);
+  if (files.empty()) {
+    files.assign(std::begin(kDefaultTraces), std::end(kDefaultTraces));
+  }
+
+  std::cout << std::left << std::setw(28) << "trace"
+            << std::right << std::setw(16) << "legacy lines/s"
+            << std::setw(16) << "buffer lines/s" << std::setw(10) << "speedup" << "\n";
+
+  for (const std::string &file : files) {
+    std::ifstream in(file, std::ios_base::binary);
+    if (!in.is_open()) {
+      std::cerr << "ERROR: failed to open trace file: " << file << "\n";
+      return 2;
+    }
+    std::string buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    uint64_t legacy_checksum = 0;
+    size_t lines = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long r = 0; r < repetitions; ++r) {
+      std::istringstream stream(buffer);
+      lines += LegacyParse(stream, legacy_checksum);
+    }
+    double legacy_rate = lines / Seconds(start);
+
+    uint64_t buffer_checksum = 0;
+    std::vector<uint32_t> hexVals;
+    lines = 0;
+    start = std::chrono::steady_clock::now();
+    for (long r = 0; r < repetitions; ++r) {
+      lines += BufferParse(buffer, hexVals, buffer_checksum);
+    }
+    double buffer_rate = lines / Seconds(start);
+
+    if (legacy_checksum != buffer_checksum) {
+      std::cerr << "ERROR: parsers disagree on " << file << "\n";
+      return 1;
+    }
+    std::cout << std::left << std::setw(28) << file << std::right << std::fixed
+              << std::setprecision(0) << std::setw(16) << legacy_rate
+              << std::setw(16) << buffer_rate
+              << std::setprecision(2) << std::setw(9) << buffer_rate / legacy_rate << "x\n";
+  }
+  return 0;
+}
@@ -3,32 +3,223 @@
  *
  * Created on August 10, 2019, 7:01 PM
  */
+#include "CompiledTrace.h"
+#include "KernelLock.h"
+#include "SwapSpace.h"
 #include "Trace.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 #include <MMU.h>
 
+#include <unistd.h>
+
 using namespace std;
+
+namespace {
+  // Commands the reader may run ahead when --pipeline has no depth
+  const size_t kDefaultPipelineDepth = 1024;
+
+  // Physical memory size, in page frames, unless --frames is given
+  const size_t kDefaultFrameCount = 64;
+
+  // Copy a process output file to stdout
+  void CopyOutput(int fd) {
+    char buffer[0x10000];
+    lseek(fd, 0, SEEK_SET);
+    ssize_t length;
+    while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+      for (ssize_t done = 0; done < length; ) {
+        ssize_t written = write(1, buffer + done, length - done);
+        if (written < 0) return;
+        done += written;
+      }
+    }
+  }
+
+  // Report paging activity when a swap file was used
+  void PrintSwapStats(const ManagePageTable &ptm, const SwapSpace *swap) {
+    if (swap == nullptr) return;
+    ManagePageTable::SwapStats stats = ptm.get_swap_stats();
+    std::cerr << "swap: " << stats.evictions << " evictions, "
+              << stats.swap_ins << " swap-ins, "
+              << stats.dirty_writebacks << " dirty writebacks\n";
+  }
+}
+
 /*
  * 
  */
 int main(int argc, char* argv[]) {
-    // Use command line argument as file name
-    if (argc != 2) {
-        std::cerr << "usage: program2 input_file\n";
+    // Compile a text trace to binary form instead of running it
+    if (argc == 4 && strcmp(argv[1], "--compile") == 0) {
+        try {
+            CompiledTrace::Compile(argv[2], argv[3]);
+        } catch (const std::runtime_error &e) {
+            std::cerr << "ERROR: " << e.what() << "\n";
+            exit(2);
+        }
+        return 0;
+    }
+
+    // Parse options; the remaining arguments are trace file names
+    TraceOptions options;
+    std::vector<const char *> file_names;
+    bool buddy = false;
+    bool zero_thread = false;
+    size_t frame_count = kDefaultFrameCount;
+    bool use_swap = false;
+    std::string swap_file_name;
+    bool usage_error = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--pipeline") == 0) {
+            options.pipeline_depth = kDefaultPipelineDepth;
+        } else if (strncmp(argv[i], "--pipeline=", 11) == 0) {
+            options.pipeline_depth = strtoul(argv[i] + 11, nullptr, 0);
+        } else if (strcmp(argv[i], "--parallel") == 0) {
+            options.parallel_workers = std::max(1u, std::thread::hardware_concurrency());
+        } else if (strncmp(argv[i], "--parallel=", 11) == 0) {
+            options.parallel_workers = strtoul(argv[i] + 11, nullptr, 0);
+            if (options.parallel_workers == 0) usage_error = true;
+        } else if (strcmp(argv[i], "--peephole") == 0) {
+            options.peephole = true;
+        } else if (strcmp(argv[i], "--no-echo") == 0) {
+            options.echo = false;
+        } else if (strcmp(argv[i], "--errors-only") == 0) {
+            options.echo = false;
+            options.dump = false;
+        } else if (strcmp(argv[i], "--contiguous") == 0) {
+            options.contiguous = true;
+        } else if (strcmp(argv[i], "--demand") == 0) {
+            options.demand_paging = true;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            options.stats = true;
+        } else if (strcmp(argv[i], "--buddy") == 0) {
+            buddy = true;
+        } else if (strncmp(argv[i], "--frames=", 9) == 0) {
+            frame_count = strtoul(argv[i] + 9, nullptr, 0);
+            if (frame_count < 2 || frame_count > BitMapAllocator::kMaxPageFrames) {
+                usage_error = true;
+            }
+        } else if (strcmp(argv[i], "--swap") == 0) {
+            use_swap = true;
+        } else if (strncmp(argv[i], "--swap=", 7) == 0) {
+            use_swap = true;
+            swap_file_name = argv[i] + 7;
+        } else if (strcmp(argv[i], "--zero-thread") == 0) {
+            zero_thread = true;
+        } else if (strncmp(argv[i], "--checkpoint=", 13) == 0) {
+            options.checkpoint_file = argv[i] + 13;
+        } else if (strncmp(argv[i], "--checkpoint-every=", 19) == 0) {
+            options.checkpoint_every = strtol(argv[i] + 19, nullptr, 0);
+            if (options.checkpoint_every <= 0) usage_error = true;
+        } else if (strncmp(argv[i], "--resume=", 9) == 0) {
+            options.resume_file = argv[i] + 9;
+        } else if (argv[i][0] != '-') {
+            file_names.push_back(argv[i]);
+        } else {
+            usage_error = true;
+        }
+    }
+    if ((options.parallel_workers > 0) + (options.pipeline_depth > 0) + options.peephole > 1) {
+        usage_error = true;
+    }
+    
+    // Checkpoints cover one process, without swap; periodic ones need
+    // commands to run one at a time
+    if (!options.checkpoint_file.empty() || !options.resume_file.empty()) {
+        if (file_names.size() > 1 || use_swap) usage_error = true;
+    }
+    if (options.checkpoint_every > 0
+            && (options.checkpoint_file.empty() || options.parallel_workers > 0)) {
+        usage_error = true;
+    }
+    if (file_names.empty() || usage_error) {
+        std::cerr << "usage: program2 [--pipeline[=depth] | --parallel[=workers] | --peephole]\n"
+                  << "                [--no-echo | --errors-only] [--zero-thread]\n"
+                  << "                [--contiguous | --demand] [--buddy] [--swap[=file]]\n"
+                  << "                [--frames=count] [--stats]\n"
+                  << "                [--checkpoint=file [--checkpoint-every=lines]]\n"
+                  << "                [--resume=file] input_file...\n"
+                  << "       program2 --compile input_file output_file\n";
         exit(1);
     }
 
-    // Create allocator and page table manager
-    mem::MMU memory(64); // fixed memory size of 64 pages
+    // Create allocator and page table manager. The kernel lock is declared
+    // first so that it outlives the background zeroing thread, which the
+    // allocator's destructor joins.
+    KernelLock kernel_lock;
+    mem::MMU memory(frame_count);
     BitMapAllocator allocator(memory);
     ManagePageTable ptm(memory, allocator);
+    if (buddy) allocator.EnableBuddy();
+    if (zero_thread) allocator.StartZeroing(kernel_lock);
+
+    // Page out to a swap file when memory runs out
+    std::unique_ptr<SwapSpace> swap;
+    if (use_swap) {
+        try {
+            swap.reset(new SwapSpace(swap_file_name));
+        } catch (const std::runtime_error &e) {
+            std::cerr << "ERROR: " << e.what() << "\n";
+            exit(2);
+        }
+        ptm.EnableSwap(*swap);
+    }
 
-    // Create the process
-    Trace process(argv[1], memory, ptm);
+    // Single process: run on this thread, writing straight to stdout
+    if (file_names.size() == 1) {
+        {
+            Trace process(file_names[0], memory, ptm, kernel_lock, options);
+            process.RunTrace();
+        }
+        PrintSwapStats(ptm, swap.get());
+        return 0;
+    }
 
-    // Run the commands
-    process.RunTrace();
-}
+    // Create one process per trace file, each with its own page table and
+    // an output file so that its output can be printed as one group
+    std::vector<std::unique_ptr<Trace>> processes;
+    std::vector<FILE *> outputs;
+    for (const char *file_name : file_names) {
+        FILE *output = tmpfile();
+        if (output == nullptr) {
+            std::cerr << "ERROR: failed to create process output file\n";
+            exit(2);
+        }
+        outputs.push_back(output);
+        TraceOptions process_options = options;
+        process_options.output_fd = fileno(output);
+        processes.emplace_back(
+                new Trace(file_name, memory, ptm, kernel_lock, process_options));
+    }
+
+    // Run each process on its own thread; the allocator takes the kernel
+    // lock itself
+    allocator.EnableThreadSafe(kernel_lock);
+    std::vector<std::thread> threads;
+    for (std::unique_ptr<Trace> &process : processes) {
+        threads.emplace_back(&Trace::RunTrace, process.get());
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    processes.clear();  // flushes output
 
+    // Print output grouped by process, in command line order
+    for (size_t i = 0; i < file_names.size(); ++i) {
+        std::cout << "==> " << file_names[i] << " <==\n" << std::flush;
+        CopyOutput(fileno(outputs[i]));
+        fclose(outputs[i]);
+    }
+    PrintSwapStats(ptm, swap.get());
+    return 0;
+}
@@ -38,6 +38,14 @@ OBJECTFILES= \
 	${OBJECTDIR}/BitMapAllocator.o \
 	${OBJECTDIR}/ManagePageTable.o \
 	${OBJECTDIR}/Trace.o \
+	${OBJECTDIR}/TranslationCache.o \
+	${OBJECTDIR}/CompiledTrace.o \
+	${OBJECTDIR}/OutputSink.o \
+	${OBJECTDIR}/BuddyAllocator.o \
+	${OBJECTDIR}/SwapSpace.o \
+	${OBJECTDIR}/TraceStats.o \
+	${OBJECTDIR}/CompareKernels.o \
+	${OBJECTDIR}/Checkpoint.o \
 	${OBJECTDIR}/main.o
 
 
@@ -55,7 +63,7 @@ FFLAGS=
 ASFLAGS=
 
 # Link Libraries and Options
-LDLIBSOPTIONS=../../Downloads/MemorySubsystemS2019/dist/Debug/CLang-Linux/libmemorysubsystems2019.a
+LDLIBSOPTIONS=../../Downloads/MemorySubsystemS2019/dist/Debug/CLang-Linux/libmemorysubsystems2019.a -lpthread
 
 # Build Targets
 .build-conf: ${BUILD_SUBPROJECTS}
@@ -82,6 +90,46 @@ ${OBJECTDIR}/Trace.o: Trace.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -I../../Downloads/MemorySubsystemS2019 -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Trace.o Trace.cpp
 
+${OBJECTDIR}/TranslationCache.o: TranslationCache.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -I../../Downloads/MemorySubsystemS2019 -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/TranslationCache.o TranslationCache.cpp
+
+${OBJECTDIR}/CompiledTrace.o: CompiledTrace.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -I../../Downloads/MemorySubsystemS2019 -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/CompiledTrace.o CompiledTrace.cpp
+
+${OBJECTDIR}/OutputSink.o: OutputSink.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -I../../Downloads/MemorySubsystemS2019 -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/OutputSink.o OutputSink.cpp
+
+${OBJECTDIR}/BuddyAllocator.o: BuddyAllocator.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -I../../Downloads/MemorySubsystemS2019 -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/BuddyAllocator.o BuddyAllocator.cpp
+
+${OBJECTDIR}/SwapSpace.o: SwapSpace.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -I../../Downloads/MemorySubsystemS2019 -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/SwapSpace.o SwapSpace.cpp
+
+${OBJECTDIR}/TraceStats.o: TraceStats.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -I../../Downloads/MemorySubsystemS2019 -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/TraceStats.o TraceStats.cpp
+
+${OBJECTDIR}/CompareKernels.o: CompareKernels.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -I../../Downloads/MemorySubsystemS2019 -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/CompareKernels.o CompareKernels.cpp
+
+${OBJECTDIR}/Checkpoint.o: Checkpoint.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -I../../Downloads/MemorySubsystemS2019 -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Checkpoint.o Checkpoint.cpp
+
 ${OBJECTDIR}/main.o: main.cpp
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -0,0 +1,476 @@
+/*
+ * File:   TraceGen.cpp
+ *
+ * Created on October 17, 2026
+ *
+ * Synthetic trace generator: writes a trace of any length in the command
+ * language of Trace to stdout, for load and scaling runs.
+ *
+ * The virtual address space is split into equal regions, each mapped with
+ * F01 except for guard pages at its end, which stay unmapped. Memory
+ * commands pick addresses with a sequential, strided, uniform random or
+ * Zipfian hot-set pattern, and opcodes by weight from the command mix.
+ * A fraction of commands is aimed at a guard page or a write-protected page
+ * to fault part way, and pages are write-protected and made writable again
+ * with FF0/FF1.
+ *
+ * The generator keeps a copy of the memory contents, updated with the same
+ * partial-completion rules as Trace, so it can follow writes with CB1/CBA
+ * lines holding the expected bytes and end with a sweep over every mapped
+ * page. A correct run of a generated trace prints no compare errors.
+ *
+ * usage: TraceGen [--commands=count] [--seed=n] [--space=bytes]
+ *                 [--regions=count] [--guard=pages]
+ *                 [--pattern=sequential|strided|random|zipf] [--stride=bytes]
+ *                 [--zipf=exponent] [--max-bytes=count] [--mix=op:weight,...]
+ *                 [--check-rate=p] [--wprotect-rate=p] [--fault-rate=p]
+ */
+
+#include <MMU.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+  const mem::Addr kPageTableEntries = mem::kPageTableSizeBytes / sizeof(mem::PageTableEntry);
+
+  // Most values on one CB1 or 301 line, and the shortest run of one value
+  // checked with CBA instead of CB1
+  const uint32_t kMaxLineValues = 16;
+  const uint32_t kMinCbaRun = 8;
+
+  // Address space pages that may be write-protected at once
+  const uint32_t kReadOnlyDivisor = 8;
+
+  // Attempts to find an address a command can use without faulting
+  const int kAddressAttempts = 16;
+
+  // State of each page of the address space
+  const uint8_t kUnmapped = 0;
+  const uint8_t kWritable = 1;
+  const uint8_t kReadOnly = 2;
+
+  enum class Pattern { kSequential, kStrided, kRandom, kZipf };
+
+  struct Options {
+    uint64_t commands = 10000;
+    uint64_t seed = 1;
+    mem::Addr space = 0x8000;
+    uint32_t regions = 4;
+    uint32_t guard_pages = 1;
+    Pattern pattern = Pattern::kRandom;
+    mem::Addr stride = 0x100;
+    double zipf_exponent = 1.0;
+    uint32_t max_bytes = 0x100;
+    double check_rate = 0.25;
+    double wprotect_rate = 0.01;
+    double fault_rate = 0.01;
+
+    // Weights of memory commands, by opcode
+    std::vector<std::pair<uint32_t, double>> mix = {
+      { 0x301, 2 }, { 0x30A, 3 }, { 0x31D, 2 }, { 0x4F0, 1 }, { 0xCB1, 1 }, { 0xCBA, 1 }
+    };
+  };
+
+  class Generator {
+  public:
+    Generator(const Options &options_, std::ostream &out_)
+    : options(options_), out(out_), rng(options_.seed),
+      page_count(options_.space / mem::kPageSize), page_states(page_count, kUnmapped),
+      data(options_.space, 0), read_only_count(0), cursor(0) {
+      out << std::hex;
+    }
+
+    void Run(void);
+
+  private:
+    // Deterministic on every platform, unlike the std distributions
+    uint64_t Uniform(uint64_t n) { return rng() % n; }
+    double Real(void) { return (rng() >> 11) * (1.0 / 9007199254740992.0); }
+
+    bool Accessible(mem::Addr addr, bool write) const {
+      if (addr >= options.space) return false;
+      uint8_t state = page_states[addr / mem::kPageSize];
+      return write ? state == kWritable : state != kUnmapped;
+    }
+
+    // Bytes from addr, up to count, before the first that would fault
+    uint32_t AccessibleRun(mem::Addr addr, uint32_t count, bool write) const {
+      uint32_t run = 0;
+      while (run < count && Accessible(addr + run, write)) ++run;
+      return run;
+    }
+
+    void MapRegions(void);
+    mem::Addr NextAddress(uint32_t count, bool retry);
+    void BuildZipf(void);
+    uint32_t PickOpcode(void);
+    void Protect(void);
+    bool PlaceFault(uint32_t count, bool write, mem::Addr &addr);
+    void MemoryCommand(void);
+    void Check(mem::Addr addr, uint32_t count);
+
+    const Options &options;
+    std::ostream &out;
+    std::mt19937_64 rng;
+
+    uint32_t page_count;
+    std::vector<uint8_t> page_states;
+    std::vector<uint8_t> data;           // expected memory contents
+    std::vector<uint32_t> guard_pages;
+    uint32_t read_only_count;
+
+    mem::Addr cursor;                    // sequential and strided patterns
+    std::vector<double> zipf_cdf;        // by rank
+    std::vector<uint32_t> zipf_pages;    // page of each rank
+  };
+
+  void Generator::Run(void) {
+    out << "* TraceGen seed " << std::dec << options.seed << ", "
+        << options.commands << " commands" << std::hex << "\n";
+    MapRegions();
+    if (options.pattern == Pattern::kZipf) BuildZipf();
+
+    for (uint64_t i = 0; i < options.commands; ++i) {
+      if (Real() < options.wprotect_rate) {
+        Protect();
+      } else {
+        MemoryCommand();
+      }
+    }
+
+    out << "* Check every mapped page\n";
+    for (uint32_t page = 0; page < page_count; ++page) {
+      if (page_states[page] != kUnmapped) Check(page * mem::kPageSize, mem::kPageSize);
+    }
+  }
+
+  void Generator::MapRegions(void) {
+    uint32_t region_pages = page_count / options.regions;
+    for (uint32_t region = 0; region < options.regions; ++region) {
+      uint32_t first = region * region_pages;
+      uint32_t mapped = region_pages - options.guard_pages;
+      out << "F01 " << mapped << " " << first * mem::kPageSize << "\n";
+      std::fill(page_states.begin() + first, page_states.begin() + first + mapped, kWritable);
+      for (uint32_t page = first + mapped; page < first + region_pages; ++page) {
+        guard_pages.push_back(page);
+      }
+    }
+  }
+
+  // Start address for a command of count bytes; on a retry after an
+  // address that would fault, sequential and strided move to the next page
+  mem::Addr Generator::NextAddress(uint32_t count, bool retry) {
+    switch (options.pattern) {
+      case Pattern::kSequential:
+      case Pattern::kStrided: {
+        mem::Addr addr = cursor;
+        if (retry) {
+          addr = (addr / mem::kPageSize + 1) * mem::kPageSize;
+        }
+        if (addr >= options.space) addr = 0;
+        cursor = addr + (options.pattern == Pattern::kSequential ? count : options.stride);
+        if (cursor >= options.space) cursor %= options.space;
+        return addr;
+      }
+      case Pattern::kRandom:
+        return Uniform(options.space);
+      case Pattern::kZipf:
+      default: {
+        size_t rank = std::upper_bound(zipf_cdf.begin(), zipf_cdf.end(), Real()) - zipf_cdf.begin();
+        rank = std::min(rank, zipf_pages.size() - 1);
+        return zipf_pages[rank] * mem::kPageSize + Uniform(mem::kPageSize);
+      }
+    }
+  }
+
+  // Zipfian page ranks over the mapped pages, hot pages scattered at random
+  void Generator::BuildZipf(void) {
+    for (uint32_t page = 0; page < page_count; ++page) {
+      if (page_states[page] != kUnmapped) zipf_pages.push_back(page);
+    }
+    for (size_t i = zipf_pages.size(); i > 1; --i) {
+      std::swap(zipf_pages[i - 1], zipf_pages[Uniform(i)]);
+    }
+    double total = 0;
+    for (size_t rank = 0; rank < zipf_pages.size(); ++rank) {
+      total += 1.0 / std::pow(rank + 1, options.zipf_exponent);
+      zipf_cdf.push_back(total);
+    }
+    for (double &p : zipf_cdf) p /= total;
+  }
+
+  uint32_t Generator::PickOpcode(void) {
+    double total = 0;
+    for (const auto &entry : options.mix) total += entry.second;
+    double pick = Real() * total;
+    for (const auto &entry : options.mix) {
+      if (pick < entry.second) return entry.first;
+      pick -= entry.second;
+    }
+    return options.mix.back().first;
+  }
+
+  // Write-protect a writable page, or make a read-only page writable again
+  // once kReadOnlyDivisor of the address space is read-only
+  void Generator::Protect(void) {
+    bool protect = read_only_count < page_count / kReadOnlyDivisor
+            && (read_only_count == 0 || Uniform(2) == 0);
+    uint8_t from = protect ? kWritable : kReadOnly;
+    std::vector<uint32_t> candidates;
+    for (uint32_t page = 0; page < page_count; ++page) {
+      if (page_states[page] == from) candidates.push_back(page);
+    }
+    if (candidates.empty()) return;
+    uint32_t page = candidates[Uniform(candidates.size())];
+    out << (protect ? "FF0 1 " : "FF1 1 ") << page * mem::kPageSize << "\n";
+    page_states[page] = protect ? kReadOnly : kWritable;
+    read_only_count += protect ? 1 : -1;
+  }
+
+  // Place a command of count bytes so it faults part way: on a guard page,
+  // or for writes possibly on a read-only page. Returns false if neither
+  // exists.
+  bool Generator::PlaceFault(uint32_t count, bool write, mem::Addr &addr) {
+    std::vector<uint32_t> targets;
+    if (write && read_only_count > 0 && (guard_pages.empty() || Uniform(2) == 0)) {
+      for (uint32_t page = 0; page < page_count; ++page) {
+        if (page_states[page] == kReadOnly) targets.push_back(page);
+      }
+    } else {
+      targets = guard_pages;
+    }
+    if (targets.empty()) return false;
+    mem::Addr fault_addr = targets[Uniform(targets.size())] * mem::kPageSize;
+    addr = fault_addr - std::min<mem::Addr>(Uniform(count), fault_addr);
+    return true;
+  }
+
+  void Generator::MemoryCommand(void) {
+    uint32_t opcode = PickOpcode();
+    bool write = opcode == 0x301 || opcode == 0x30A || opcode == 0x31D;
+    uint32_t max_count = (opcode == 0x301 || opcode == 0xCB1) ? kMaxLineValues : options.max_bytes;
+    uint32_t count = 1 + Uniform(max_count);
+
+    mem::Addr addr = 0;
+    bool fault = Real() < options.fault_rate && PlaceFault(count, write, addr);
+    if (!fault) {
+      // Shorten the command to the bytes it can reach without faulting
+      uint32_t run = 0;
+      for (int attempt = 0; attempt < kAddressAttempts && run == 0; ++attempt) {
+        addr = NextAddress(count, attempt > 0);
+        run = AccessibleRun(addr, count, write);
+      }
+      if (run == 0) return;
+      count = run;
+    }
+
+    // Update the expected contents as Trace will: low to high address,
+    // stopping at the first byte that faults
+    switch (opcode) {
+      case 0x301: {
+        uint32_t run = AccessibleRun(addr, count, true);
+        out << "301 " << addr;
+        for (uint32_t i = 0; i < count; ++i) {
+          uint8_t value = Uniform(0x100);
+          out << " " << uint32_t(value);
+          if (i < run) data[addr + i] = value;
+        }
+        out << "\n";
+        break;
+      }
+      case 0x30A: {
+        uint8_t value = Uniform(0x100);
+        out << "30A " << count << " " << addr << " " << uint32_t(value) << "\n";
+        uint32_t run = AccessibleRun(addr, count, true);
+        std::fill(data.begin() + addr, data.begin() + addr + run, value);
+        break;
+      }
+      case 0x31D: {
+        // Source anywhere readable
+        mem::Addr src = 0;
+        uint32_t src_run = 0;
+        for (int attempt = 0; attempt < kAddressAttempts && src_run == 0; ++attempt) {
+          src = Uniform(options.space);
+          src_run = AccessibleRun(src, count, false);
+        }
+        if (src_run == 0) return;
+        if (!fault) count = std::min(count, src_run);
+        out << "31D " << count << " " << addr << " " << src << "\n";
+        for (uint32_t i = 0; i < count; ++i) {
+          if (!Accessible(src + i, false) || !Accessible(addr + i, true)) break;
+          data[addr + i] = data[src + i];
+        }
+        break;
+      }
+      case 0x4F0:
+        out << "4F0 " << count << " " << addr << "\n";
+        break;
+      case 0xCB1: {
+        out << "CB1 " << addr;
+        for (uint32_t i = 0; i < count; ++i) {
+          out << " " << uint32_t(addr + i < options.space ? data[addr + i] : 0);
+        }
+        out << "\n";
+        break;
+      }
+      case 0xCBA:
+      default: {
+        // Check a run of one value; a fault is kept only if every byte
+        // before it holds that value
+        uint32_t readable = AccessibleRun(addr, count, false);
+        uint32_t run = (readable > 0) ? 1 : 0;
+        while (run < readable && data[addr + run] == data[addr]) ++run;
+        if (run < readable || !fault) count = run;
+        out << "CBA " << count << " " << addr << " "
+            << uint32_t(readable > 0 ? data[addr] : 0) << "\n";
+        break;
+      }
+    }
+
+    if (write && Real() < options.check_rate) {
+      uint32_t written = AccessibleRun(addr, count, true);
+      if (written > 0) Check(addr, written);
+    }
+  }
+
+  // Check count bytes from addr against the expected contents: runs of one
+  // value with CBA, the rest with CB1
+  void Generator::Check(mem::Addr addr, uint32_t count) {
+    mem::Addr end = addr + count;
+    while (addr < end) {
+      mem::Addr run_end = addr + 1;
+      while (run_end < end && data[run_end] == data[addr]) ++run_end;
+      if (run_end - addr >= kMinCbaRun) {
+        out << "CBA " << run_end - addr << " " << addr << " " << uint32_t(data[addr]) << "\n";
+        addr = run_end;
+        continue;
+      }
+
+      // CB1 up to the next long run
+      mem::Addr line_end = addr;
+      while (line_end < end && line_end - addr < kMaxLineValues) {
+        mem::Addr next = line_end + 1;
+        while (next < end && next - line_end < kMinCbaRun && data[next] == data[line_end]) ++next;
+        if (next - line_end >= kMinCbaRun) break;
+        line_end = std::min<mem::Addr>(next, addr + kMaxLineValues);
+      }
+      out << "CB1 " << addr;
+      for (mem::Addr a = addr; a < line_end; ++a) out << " " << uint32_t(data[a]);
+      out << "\n";
+      addr = line_end;
+    }
+  }
+
+  bool ParseMix(const char *text, std::vector<std::pair<uint32_t, double>> &mix) {
+    static const uint32_t kOpcodes[] = { 0x301, 0x30A, 0x31D, 0x4F0, 0xCB1, 0xCBA };
+    mix.clear();
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+      char *end;
+      uint32_t opcode = strtoul(item.c_str(), &end, 16);
+      if (*end != ':' || std::find(std::begin(kOpcodes), std::end(kOpcodes), opcode) == std::end(kOpcodes)) {
+        return false;
+      }
+      double weight = strtod(end + 1, &end);
+      if (*end != '\0' || weight < 0) return false;
+      mix.emplace_back(opcode, weight);
+    }
+    double total = 0;
+    for (const auto &entry : mix) total += entry.second;
+    return total > 0;
+  }
+
+  // Value of "--name=value" if arg is that option
+  const char *OptionValue(const char *arg, const char *name) {
+    size_t length = strlen(name);
+    return (strncmp(arg, name, length) == 0 && arg[length] == '=') ? arg + length + 1 : nullptr;
+  }
+
+  bool ParseRate(const char *text, double &rate) {
+    char *end;
+    rate = strtod(text, &end);
+    return *end == '\0' && rate >= 0 && rate <= 1;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  Options options;
+  bool ok = true;
+  for (int i = 1; i < argc && ok; ++i) {
+    const char *value;
+    if ((value = OptionValue(argv[i], "--commands"))) {
+      options.commands = strtoull(value, nullptr, 0);
+    } else if ((value = OptionValue(argv[i], "--seed"))) {
+      options.seed = strtoull(value, nullptr, 0);
+    } else if ((value = OptionValue(argv[i], "--space"))) {
+      options.space = strtoul(value, nullptr, 0);
+    } else if ((value = OptionValue(argv[i], "--regions"))) {
+      options.regions = strtoul(value, nullptr, 0);
+    } else if ((value = OptionValue(argv[i], "--guard"))) {
+      options.guard_pages = strtoul(value, nullptr, 0);
+    } else if ((value = OptionValue(argv[i], "--pattern"))) {
+      std::string name = value;
+      if (name == "sequential") options.pattern = Pattern::kSequential;
+      else if (name == "strided") options.pattern = Pattern::kStrided;
+      else if (name == "random") options.pattern = Pattern::kRandom;
+      else if (name == "zipf") options.pattern = Pattern::kZipf;
+      else ok = false;
+    } else if ((value = OptionValue(argv[i], "--stride"))) {
+      options.stride = strtoul(value, nullptr, 0);
+    } else if ((value = OptionValue(argv[i], "--zipf"))) {
+      options.zipf_exponent = strtod(value, nullptr);
+    } else if ((value = OptionValue(argv[i], "--max-bytes"))) {
+      options.max_bytes = strtoul(value, nullptr, 0);
+    } else if ((value = OptionValue(argv[i], "--mix"))) {
+      ok = ParseMix(value, options.mix);
+    } else if ((value = OptionValue(argv[i], "--check-rate"))) {
+      ok = ParseRate(value, options.check_rate);
+    } else if ((value = OptionValue(argv[i], "--wprotect-rate"))) {
+      ok = ParseRate(value, options.wprotect_rate);
+    } else if ((value = OptionValue(argv[i], "--fault-rate"))) {
+      ok = ParseRate(value, options.fault_rate);
+    } else {
+      ok = false;
+    }
+  }
+  if (!ok) {
+    std::cerr << "usage: TraceGen [--commands=count] [--seed=n] [--space=bytes]\n"
+              << "                [--regions=count] [--guard=pages]\n"
+              << "                [--pattern=sequential|strided|random|zipf] [--stride=bytes]\n"
+              << "                [--zipf=exponent] [--max-bytes=count] [--mix=op:weight,...]\n"
+              << "                [--check-rate=p] [--wprotect-rate=p] [--fault-rate=p]\n";
+    return 2;
+  }
+
+  uint32_t pages = options.space / mem::kPageSize;
+  if (options.space % mem::kPageSize != 0 || pages == 0 || pages > kPageTableEntries) {
+    std::cerr << "ERROR: space must be a multiple of " << mem::kPageSize
+              << " up to " << kPageTableEntries * mem::kPageSize << " bytes\n";
+    return 2;
+  }
+  if (options.regions == 0 || pages % options.regions != 0
+          || pages / options.regions <= options.guard_pages) {
+    std::cerr << "ERROR: regions must divide the " << pages
+              << " pages, with more pages in each than guard pages\n";
+    return 2;
+  }
+  if (options.max_bytes == 0 || options.stride == 0 || options.zipf_exponent <= 0) {
+    std::cerr << "ERROR: max-bytes, stride and zipf must be positive\n";
+    return 2;
+  }
+
+  std::ios_base::sync_with_stdio(false);
+  Generator(options, std::cout).Run();
+  return 0;
+}
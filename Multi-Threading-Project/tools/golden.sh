@@ -0,0 +1,144 @@
+#!/bin/bash
+#
+# File:   golden.sh
+#
+# Created on October 17, 2026
+#
+# Golden-output regression runner: runs every trace*v*.txt under each set
+# of simulator options, in parallel across cores, and compares its stdout
+# with the checked-in expected/<trace>.out. Prints pass/fail and wall time
+# per run, and a diff of each failure. With --bless, runs each trace with
+# no options and rewrites its expected output instead.
+#
+# usage: tools/golden.sh [--bless] [-j jobs] [-o "options"]... program [trace_file...]
+#
+# Run from the project directory. Without -o, each trace is run with no
+# options and with --demand, --buddy, --contiguous, --pipeline, --parallel,
+# --peephole, --swap, --swap --frames=8 (which forces eviction) and
+# --zero-thread, all of which must produce the same output. A trace with
+# FC0 commands is also run under each option set without --swap with
+# --checkpoint, then again with --resume, whose output must match the
+# expected output from the line after the last FC0 on.
+
+bless=0
+jobs=$(nproc 2>/dev/null || echo 4)
+option_sets=()
+while [ $# -gt 0 ]; do
+  case "$1" in
+    --bless) bless=1; shift ;;
+    -j) jobs="$2"; shift 2 ;;
+    -o) option_sets+=("$2"); shift 2 ;;
+    *) break ;;
+  esac
+done
+if [ $# -lt 1 ] || ! [ "$jobs" -gt 0 ] 2>/dev/null; then
+  echo "usage: tools/golden.sh [--bless] [-j jobs] [-o \"options\"]... program [trace_file...]" >&2
+  exit 2
+fi
+program="$1"
+shift
+if [ ! -x "$program" ]; then
+  echo "ERROR: $program is not an executable" >&2
+  exit 2
+fi
+traces=("$@")
+if [ ${#traces[@]} -eq 0 ]; then
+  traces=(trace*v*.txt)
+fi
+if [ $bless -eq 1 ]; then
+  option_sets=("")
+elif [ ${#option_sets[@]} -eq 0 ]; then
+  option_sets=("" "--demand" "--buddy" "--contiguous" "--pipeline" "--parallel" "--peephole"
+               "--swap" "--swap --frames=8" "--zero-thread")
+fi
+
+# Each trace under each option set, and a checkpoint then resume of each
+# trace with FC0 commands where checkpoints are available
+job_traces=()
+job_options=()
+job_resume=()
+for trace in "${traces[@]}"; do
+  for options in "${option_sets[@]}"; do
+    job_traces+=("$trace")
+    job_options+=("$options")
+    job_resume+=(0)
+    if [ $bless -eq 0 ] && [[ "$options" != *--swap* ]] \
+         && grep -qi '^[[:space:]]*fc0' "$trace"; then
+      job_traces+=("$trace")
+      job_options+=("$options")
+      job_resume+=(1)
+    fi
+  done
+done
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# Run one trace with one option set, or with resume, checkpoint it and
+# resume from its last checkpoint; leaves the (resumed) output, status and
+# milliseconds taken in $work/<job>.*
+run() {
+  local job="$1" trace="$2" options="$3" resume="$4"
+  local start=$(date +%s%N)
+  # options are split into words on purpose
+  if [ "$resume" -eq 1 ]; then
+    "$program" $options --checkpoint="$work/$job.ckpt" "$trace" > /dev/null 2> "$work/$job.err" \
+      && "$program" $options --resume="$work/$job.ckpt" "$trace" > "$work/$job.out" 2>> "$work/$job.err"
+  else
+    "$program" $options "$trace" > "$work/$job.out" 2> "$work/$job.err"
+  fi
+  echo $? > "$work/$job.status"
+  echo $(( ($(date +%s%N) - start) / 1000000 )) > "$work/$job.ms"
+}
+
+start=$(date +%s%N)
+for job in "${!job_traces[@]}"; do
+  while [ $(jobs -rp | wc -l) -ge "$jobs" ]; do
+    wait -n
+  done
+  run $job "${job_traces[$job]}" "${job_options[$job]}" "${job_resume[$job]}" &
+done
+wait
+
+failed=0
+for job in "${!job_traces[@]}"; do
+  trace="${job_traces[$job]}"
+  options="${job_options[$job]}"
+  expected="expected/$(basename "$trace").out"
+  status=$(cat "$work/$job.status")
+  ms=$(cat "$work/$job.ms")
+  label="$trace${options:+ $options}"
+  if [ "${job_resume[$job]}" -eq 1 ]; then
+    label="$label --checkpoint/--resume"
+    # Expected output from the line after the last checkpoint on
+    last=$(grep -ni '^[[:space:]]*fc0' "$trace" | tail -1 | cut -d: -f1)
+    if [ -f "$expected" ]; then
+      sed -n "/^$((last + 1)):/,\$p" "$expected" > "$work/$job.expected"
+      expected="$work/$job.expected"
+    fi
+  fi
+  if [ $bless -eq 1 ]; then
+    if [ "$status" -eq 0 ]; then
+      mkdir -p expected
+      cp "$work/$job.out" "$expected"
+      printf "BLESS %6d ms  %s\n" "$ms" "$label"
+    else
+      printf "FAIL  %6d ms  %s (exit %d)\n" "$ms" "$label" "$status"
+      failed=$((failed + 1))
+    fi
+  elif [ "$status" -eq 0 ] && cmp -s "$expected" "$work/$job.out"; then
+    printf "PASS  %6d ms  %s\n" "$ms" "$label"
+  else
+    printf "FAIL  %6d ms  %s (exit %d)\n" "$ms" "$label" "$status"
+    if [ -f "$expected" ]; then
+      diff -u "$expected" "$work/$job.out" | head -20
+    else
+      echo "  no $expected; run with --bless to create it"
+    fi
+    sed 's/^/  stderr: /' "$work/$job.err" | head -5
+    failed=$((failed + 1))
+  fi
+done
+
+echo "${#job_traces[@]} runs, $failed failed, $(( ($(date +%s%N) - start) / 1000000 )) ms"
+[ $failed -eq 0 ]